@@ -13,8 +13,11 @@
 #include "ui/widgets/input_fields.h"
 #include "base/qthelp_url.h"
 #include "styles/style_wallet.h"
+#include "crl/crl_queue.h"
 
 #include <QtCore/QLocale>
+#include <QtCore/QFile>
+#include <QtCore/QSaveFile>
 
 namespace Wallet {
 namespace {
@@ -22,6 +25,11 @@ namespace {
 constexpr auto kOneGram = 1'000'000'000;
 constexpr auto kNanoDigits = 9;
 
+[[nodiscard]] crl::queue &FilesQueue() {
+	static auto result = crl::queue();
+	return result;
+}
+
 struct FixedAmount {
 	QString text;
 	int position = 0;
@@ -221,6 +229,10 @@ PreparedInvoice ParseInvoice(QString invoice) {
 	return result;
 }
 
+size_t TransactionIdHash::operator()(const Ton::TransactionId &id) const {
+	return size_t(qHash(id.hash)) ^ std::hash<int64>()(id.lt);
+}
+
 int64 CalculateValue(const Ton::Transaction &data) {
 	const auto outgoing = ranges::accumulate(
 		data.outgoing,
@@ -412,4 +424,30 @@ Ton::TransactionToSend TransactionFromInvoice(
 	return result;
 }
 
+void SaveFileAsync(const QString &path, Fn<QByteArray()> bytes) {
+	if (path.isEmpty()) {
+		return;
+	}
+	FilesQueue().async([=] {
+		const auto data = bytes();
+		if (data.isEmpty()) {
+			return;
+		}
+		auto file = QSaveFile(path);
+		if (file.open(QIODevice::WriteOnly)
+			&& file.write(data) == data.size()) {
+			file.commit();
+		}
+	});
+}
+
+void RemoveFileAsync(const QString &path) {
+	if (path.isEmpty()) {
+		return;
+	}
+	FilesQueue().async([=] {
+		QFile::remove(path);
+	});
+}
+
 } // namespace Wallet
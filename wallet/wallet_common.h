@@ -11,6 +11,7 @@
 namespace Ton {
 struct Error;
 struct Transaction;
+struct TransactionId;
 struct TransactionToSend;
 } // namespace Ton
 
@@ -43,13 +44,20 @@ struct PreparedInvoice {
 	bool sendUnencryptedText = false;
 };
 
+struct TransactionIdHash {
+	[[nodiscard]] size_t operator()(const Ton::TransactionId &id) const;
+};
+
 enum class Action {
 	Refresh,
 	Export,
+	ExportHistory,
 	Send,
 	Receive,
 	ChangePassword,
 	ShowSettings,
+	ToggleBalances,
+	SwitchAccount,
 	LogOut,
 };
 
@@ -100,4 +108,10 @@ not_null<Ui::FlatLabel*> AddBoxSubtitle(
 [[nodiscard]] Ton::TransactionToSend TransactionFromInvoice(
 	const PreparedInvoice &invoice);
 
+// Wallet data files are written and removed in the background one after
+// another, so a removal never races with an earlier write. The bytes are
+// computed there as well, an empty result skips the write.
+void SaveFileAsync(const QString &path, Fn<QByteArray()> bytes);
+void RemoveFileAsync(const QString &path);
+
 } // namespace Wallet
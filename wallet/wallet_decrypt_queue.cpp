@@ -0,0 +1,145 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "wallet/wallet_decrypt_queue.h"
+
+namespace Wallet {
+namespace {
+
+constexpr auto kChunkSize = 16;
+
+} // namespace
+
+DecryptQueue::DecryptQueue(Decrypt decrypt) : _decrypt(std::move(decrypt)) {
+	Expects(_decrypt != nullptr);
+}
+
+void DecryptQueue::push(CollectedEncrypted &&collected) {
+	auto failed = std::vector<Ton::Transaction>();
+	enqueue(collected.viewed, DecryptPriority::Viewed, failed);
+	enqueue(collected.visible, DecryptPriority::Visible, failed);
+	enqueue(collected.background, DecryptPriority::Background, failed);
+	if (!failed.empty()) {
+		_decrypted.fire(&failed);
+	}
+	sendNext();
+}
+
+void DecryptQueue::push(
+		const std::vector<Ton::Transaction> &list,
+		DecryptPriority priority) {
+	auto failed = std::vector<Ton::Transaction>();
+	enqueue(list, priority, failed);
+	if (!failed.empty()) {
+		_decrypted.fire(&failed);
+	}
+	sendNext();
+}
+
+void DecryptQueue::enqueue(
+		const std::vector<Ton::Transaction> &list,
+		DecryptPriority priority,
+		std::vector<Ton::Transaction> &failed) {
+	for (const auto &data : list) {
+		const auto &id = data.id;
+		if (!IsEncryptedMessage(data)
+			|| _done.count(id)
+			|| _sending.count(id)) {
+			continue;
+		} else if (_failed.count(id)) {
+			// Report it again, so that a newly opened box shows the error.
+			failed.push_back(data);
+			continue;
+		}
+		const auto i = _queued.find(id);
+		if (i == end(_queued)) {
+			_queued.emplace(id, priority);
+		} else if (i->second < priority) {
+			i->second = priority;
+		} else {
+			continue;
+		}
+		_queues[int(priority)].push_back(data);
+	}
+}
+
+void DecryptQueue::cancel() {
+	for (auto &queue : _queues) {
+		queue.clear();
+	}
+	_queued.clear();
+}
+
+void DecryptQueue::sendNext() {
+	if (!_sending.empty()) {
+		return;
+	}
+	auto chunk = std::vector<Ton::Transaction>();
+	for (auto priority = int(_queues.size()); priority > 0;) {
+		auto &queue = _queues[--priority];
+		while (!queue.empty() && int(chunk.size()) < kChunkSize) {
+			auto data = std::move(queue.front());
+			queue.pop_front();
+			const auto i = _queued.find(data.id);
+			if (i == end(_queued) || int(i->second) != priority) {
+				continue;
+			}
+			_queued.erase(i);
+			_sending.emplace(data.id);
+			chunk.push_back(std::move(data));
+		}
+	}
+	if (chunk.empty()) {
+		return;
+	}
+	_decrypt(std::move(chunk), crl::guard(this, [=](Result result) {
+		chunkDone(std::move(result));
+	}));
+}
+
+void DecryptQueue::chunkDone(Result result) {
+	_sending.clear();
+	if (!result) {
+		// Nothing is marked as failed, so asking again retries the chunk.
+		cancel();
+		_errors.fire_copy(result.error());
+		return;
+	}
+	apply(result.value());
+}
+
+void DecryptQueue::apply(const std::vector<Ton::Transaction> &list) {
+	for (const auto &data : list) {
+		// Entries left in _queues without _queued are skipped later.
+		_queued.erase(data.id);
+		if (IsEncryptedMessage(data)) {
+			_failed.emplace(data.id);
+		} else {
+			_done.emplace(data.id);
+		}
+	}
+	if (!list.empty()) {
+		_decrypted.fire(&list);
+	}
+	sendNext();
+}
+
+void DecryptQueue::forget(const std::vector<Ton::TransactionId> &ids) {
+	for (const auto &id : ids) {
+		_done.erase(id);
+	}
+}
+
+rpl::producer<not_null<const std::vector<Ton::Transaction>*>>
+DecryptQueue::decrypted() const {
+	return _decrypted.events();
+}
+
+rpl::producer<Ton::Error> DecryptQueue::errors() const {
+	return _errors.events();
+}
+
+} // namespace Wallet
@@ -0,0 +1,94 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "ton/ton_state.h"
+#include "ton/ton_result.h"
+#include "base/weak_ptr.h"
+#include "wallet/wallet_common.h"
+
+#include <array>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace Wallet {
+
+enum class DecryptPriority {
+	Background,
+	Visible,
+	Viewed,
+};
+
+// Encrypted transactions gathered for decryption, by priority.
+struct CollectedEncrypted {
+	std::vector<Ton::Transaction> viewed;
+	std::vector<Ton::Transaction> visible;
+	std::vector<Ton::Transaction> background;
+};
+
+// Sends encrypted comments for decryption in bounded chunks, one chunk
+// at a time and the most important ones first. Comments that were
+// already decrypted or failed to decrypt are not sent again, unless
+// the decrypted ones are forgotten.
+class DecryptQueue final : public base::has_weak_ptr {
+public:
+	using Result = Ton::Result<std::vector<Ton::Transaction>>;
+	using Decrypt = Fn<void(std::vector<Ton::Transaction>, Fn<void(Result)>)>;
+
+	explicit DecryptQueue(Decrypt decrypt);
+
+	void push(CollectedEncrypted &&collected);
+	void push(
+		const std::vector<Ton::Transaction> &list,
+		DecryptPriority priority);
+
+	// Drops everything not sent yet, the chunk being decrypted
+	// still delivers its results.
+	void cancel();
+
+	// Takes comments decrypted elsewhere, for example read from a cache.
+	void apply(const std::vector<Ton::Transaction> &list);
+
+	// Lets the comments be decrypted again, when the caller has lost
+	// the decrypted copies, for example after the list was reloaded.
+	void forget(const std::vector<Ton::TransactionId> &ids);
+
+	[[nodiscard]] rpl::producer<
+		not_null<const std::vector<Ton::Transaction>*>> decrypted() const;
+	[[nodiscard]] rpl::producer<Ton::Error> errors() const;
+
+private:
+	using IdSet = std::unordered_set<Ton::TransactionId, TransactionIdHash>;
+
+	void enqueue(
+		const std::vector<Ton::Transaction> &list,
+		DecryptPriority priority,
+		std::vector<Ton::Transaction> &failed);
+	void sendNext();
+	void chunkDone(Result result);
+
+	const Decrypt _decrypt;
+
+	// Entries whose priority was raised later stay in the lower queue,
+	// they are skipped there because _queued has the new priority.
+	std::array<std::deque<Ton::Transaction>, 3> _queues;
+	std::unordered_map<
+		Ton::TransactionId,
+		DecryptPriority,
+		TransactionIdHash> _queued;
+	IdSet _sending;
+	IdSet _done;
+	IdSet _failed;
+
+	rpl::event_stream<
+		not_null<const std::vector<Ton::Transaction>*>> _decrypted;
+	rpl::event_stream<Ton::Error> _errors;
+
+};
+
+} // namespace Wallet
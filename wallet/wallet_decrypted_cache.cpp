@@ -0,0 +1,411 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "wallet/wallet_decrypted_cache.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QDataStream>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+namespace Wallet {
+namespace {
+
+constexpr auto kCacheMagic = quint32(0x57444543);
+constexpr auto kCacheVersion = qint32(1);
+constexpr auto kCommentsMax = 100'000;
+constexpr auto kMessagesMax = 256;
+constexpr auto kSaltSize = 32;
+constexpr auto kKeySize = 32;
+constexpr auto kIvSize = 12;
+constexpr auto kTagSize = 16;
+constexpr auto kKeyIterations = 100'000;
+constexpr auto kSaveDelay = 5 * crl::time(1000);
+
+using CipherContext = std::unique_ptr<
+	EVP_CIPHER_CTX,
+	decltype(&EVP_CIPHER_CTX_free)>;
+
+struct Stored {
+	QByteArray salt;
+	QByteArray encrypted;
+};
+
+[[nodiscard]] const uchar *Bytes(const QByteArray &data) {
+	return reinterpret_cast<const uchar*>(data.constData());
+}
+
+[[nodiscard]] uchar *Bytes(QByteArray &data) {
+	return reinterpret_cast<uchar*>(data.data());
+}
+
+[[nodiscard]] CipherContext MakeCipherContext() {
+	return CipherContext(EVP_CIPHER_CTX_new(), &EVP_CIPHER_CTX_free);
+}
+
+[[nodiscard]] QByteArray RandomBytes(int size) {
+	auto result = QByteArray(size, Qt::Uninitialized);
+	if (RAND_bytes(Bytes(result), size) != 1) {
+		return QByteArray();
+	}
+	return result;
+}
+
+[[nodiscard]] QByteArray DeriveKey(
+		const QByteArray &passcode,
+		const QByteArray &salt) {
+	auto result = QByteArray(kKeySize, Qt::Uninitialized);
+	const auto ok = PKCS5_PBKDF2_HMAC(
+		passcode.constData(),
+		passcode.size(),
+		Bytes(salt),
+		salt.size(),
+		kKeyIterations,
+		EVP_sha512(),
+		kKeySize,
+		Bytes(result));
+	return (ok == 1) ? result : QByteArray();
+}
+
+// AES-256-GCM, the result is the iv, then the tag, then the ciphertext.
+[[nodiscard]] QByteArray Encrypt(
+		const QByteArray &key,
+		const QByteArray &data) {
+	Expects(key.size() == kKeySize);
+
+	const auto iv = RandomBytes(kIvSize);
+	const auto context = MakeCipherContext();
+	if (iv.isEmpty() || !context) {
+		return QByteArray();
+	}
+	auto result = QByteArray(
+		kIvSize + kTagSize + data.size(),
+		Qt::Uninitialized);
+	const auto tag = Bytes(result) + kIvSize;
+	const auto out = tag + kTagSize;
+	auto written = 0;
+	auto finished = 0;
+	if (EVP_EncryptInit_ex(
+			context.get(),
+			EVP_aes_256_gcm(),
+			nullptr,
+			Bytes(key),
+			Bytes(iv)) != 1
+		|| EVP_EncryptUpdate(
+			context.get(),
+			out,
+			&written,
+			Bytes(data),
+			data.size()) != 1
+		|| EVP_EncryptFinal_ex(context.get(), out + written, &finished) != 1
+		|| EVP_CIPHER_CTX_ctrl(
+			context.get(),
+			EVP_CTRL_GCM_GET_TAG,
+			kTagSize,
+			tag) != 1) {
+		return QByteArray();
+	}
+	std::copy(iv.begin(), iv.end(), result.begin());
+	return result;
+}
+
+[[nodiscard]] std::optional<QByteArray> Decrypt(
+		const QByteArray &key,
+		const QByteArray &data) {
+	Expects(key.size() == kKeySize);
+
+	const auto context = MakeCipherContext();
+	if (data.size() < kIvSize + kTagSize || !context) {
+		return std::nullopt;
+	}
+	auto tag = data.mid(kIvSize, kTagSize);
+	const auto in = Bytes(data) + kIvSize + kTagSize;
+	const auto size = data.size() - kIvSize - kTagSize;
+	auto result = QByteArray(size, Qt::Uninitialized);
+	auto written = 0;
+	auto finished = 0;
+	if (EVP_DecryptInit_ex(
+			context.get(),
+			EVP_aes_256_gcm(),
+			nullptr,
+			Bytes(key),
+			Bytes(data)) != 1
+		|| EVP_DecryptUpdate(
+			context.get(),
+			Bytes(result),
+			&written,
+			in,
+			size) != 1
+		|| EVP_CIPHER_CTX_ctrl(
+			context.get(),
+			EVP_CTRL_GCM_SET_TAG,
+			kTagSize,
+			Bytes(tag)) != 1
+		|| EVP_DecryptFinal_ex(
+			context.get(),
+			Bytes(result) + written,
+			&finished) != 1) {
+		// Wrong key, most likely the passcode was changed.
+		return std::nullopt;
+	}
+	return result;
+}
+
+[[nodiscard]] std::optional<Stored> ReadStored(const QString &path) {
+	auto file = QFile(path);
+	if (path.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+		return std::nullopt;
+	}
+	auto stream = QDataStream(&file);
+	stream.setVersion(QDataStream::Qt_5_6);
+
+	auto magic = quint32();
+	auto version = qint32();
+	auto result = Stored();
+	stream >> magic >> version >> result.salt >> result.encrypted;
+	if (stream.status() != QDataStream::Ok
+		|| magic != kCacheMagic
+		|| version != kCacheVersion
+		|| result.salt.size() != kSaltSize) {
+		return std::nullopt;
+	}
+	return result;
+}
+
+[[nodiscard]] QByteArray SerializeStored(const Stored &stored) {
+	auto result = QByteArray();
+	auto stream = QDataStream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_6);
+	stream << kCacheMagic << kCacheVersion << stored.salt << stored.encrypted;
+	return result;
+}
+
+template <typename Map>
+[[nodiscard]] QByteArray Serialize(const Map &map) {
+	auto result = QByteArray();
+	auto stream = QDataStream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_6);
+	stream << qint32(map.size());
+	for (const auto &[id, comments] : map) {
+		stream << qint64(id.lt) << id.hash << qint32(comments.size());
+		for (const auto &text : comments) {
+			stream << text;
+		}
+	}
+	return result;
+}
+
+template <typename Map>
+[[nodiscard]] Map Deserialize(const QByteArray &bytes) {
+	auto stream = QDataStream(bytes);
+	stream.setVersion(QDataStream::Qt_5_6);
+
+	auto count = qint32();
+	stream >> count;
+	if (stream.status() != QDataStream::Ok
+		|| count < 0
+		|| count > kCommentsMax) {
+		return Map();
+	}
+	auto result = Map();
+	result.reserve(count);
+	for (auto i = 0; i != count; ++i) {
+		auto id = Ton::TransactionId();
+		auto lt = qint64();
+		auto size = qint32();
+		stream >> lt >> id.hash >> size;
+		if (stream.status() != QDataStream::Ok
+			|| size < 0
+			|| size > kMessagesMax) {
+			return Map();
+		}
+		id.lt = lt;
+		auto &comments = result[id];
+		comments.resize(size);
+		for (auto &text : comments) {
+			stream >> text;
+		}
+	}
+	return (stream.status() == QDataStream::Ok) ? result : Map();
+}
+
+[[nodiscard]] std::vector<QString> ExtractComments(
+		const Ton::Transaction &data) {
+	const auto extract = [](const Ton::Message &message) {
+		const auto &text = message.message;
+		return text.decrypted ? text.text : QString();
+	};
+	auto result = std::vector<QString>();
+	result.reserve(data.outgoing.size() + 1);
+	result.push_back(extract(data.incoming));
+	for (const auto &message : data.outgoing) {
+		result.push_back(extract(message));
+	}
+	return ranges::any_of(result, [](const QString &text) {
+		return !text.isNull();
+	}) ? result : std::vector<QString>();
+}
+
+void ApplyComments(
+		Ton::Transaction &data,
+		const std::vector<QString> &comments) {
+	const auto apply = [&](Ton::Message &message, int index) {
+		auto &text = message.message;
+		if (index < int(comments.size())
+			&& !comments[index].isNull()
+			&& !text.encrypted.isEmpty()
+			&& !text.decrypted) {
+			text.text = comments[index];
+			text.decrypted = true;
+		}
+	};
+	apply(data.incoming, 0);
+	for (auto i = 0, count = int(data.outgoing.size()); i != count; ++i) {
+		apply(data.outgoing[i], i + 1);
+	}
+}
+
+} // namespace
+
+DecryptedCache::DecryptedCache(const QString &path)
+: _path(path)
+, _saveTimer([=] { save(); }) {
+}
+
+DecryptedCache::~DecryptedCache() {
+	if (_saveTimer.isActive()) {
+		save();
+	}
+}
+
+void DecryptedCache::unlock(const QByteArray &passcode) {
+	if (_path.isEmpty()
+		|| passcode.isEmpty()
+		|| _unlocking
+		|| unlocked()) {
+		return;
+	}
+	_unlocking = true;
+	const auto weak = base::make_weak(this);
+	crl::async([=, path = _path] {
+		const auto stored = ReadStored(path);
+		const auto salt = stored ? stored->salt : RandomBytes(kSaltSize);
+		const auto key = salt.isEmpty()
+			? QByteArray()
+			: DeriveKey(passcode, salt);
+		auto map = Map();
+		if (stored && !key.isEmpty()) {
+			if (const auto decrypted = Decrypt(key, stored->encrypted)) {
+				map = Deserialize<Map>(*decrypted);
+			}
+		}
+		crl::on_main(weak, [=, map = std::move(map)]() mutable {
+			loaded(key, salt, std::move(map));
+		});
+	});
+}
+
+void DecryptedCache::loaded(
+		const QByteArray &key,
+		const QByteArray &salt,
+		Map &&map) {
+	_unlocking = false;
+	if (key.isEmpty()) {
+		return;
+	}
+	_key = key;
+	_salt = salt;
+
+	// Comments decrypted in this session before the unlock stay.
+	const auto known = map.size();
+	for (auto &[id, comments] : map) {
+		_comments.emplace(id, std::move(comments));
+	}
+	if (_comments.size() != known) {
+		_saveTimer.callOnce(kSaveDelay);
+	}
+	_unlocks.fire({});
+}
+
+bool DecryptedCache::unlocked() const {
+	return !_key.isEmpty();
+}
+
+rpl::producer<> DecryptedCache::unlocks() const {
+	return _unlocks.events();
+}
+
+bool DecryptedCache::empty() const {
+	return _comments.empty();
+}
+
+std::vector<Ton::Transaction> DecryptedCache::lookup(
+		const std::vector<Ton::Transaction> &list) const {
+	auto result = std::vector<Ton::Transaction>();
+	if (_comments.empty()) {
+		return result;
+	}
+	for (const auto &data : list) {
+		if (!IsEncryptedMessage(data)) {
+			continue;
+		}
+		const auto i = _comments.find(data.id);
+		if (i == end(_comments)) {
+			continue;
+		}
+		auto decrypted = data;
+		ApplyComments(decrypted, i->second);
+		if (!IsEncryptedMessage(decrypted)) {
+			result.push_back(std::move(decrypted));
+		}
+	}
+	return result;
+}
+
+void DecryptedCache::store(const std::vector<Ton::Transaction> &list) {
+	auto changed = false;
+	for (const auto &data : list) {
+		if (IsEncryptedMessage(data)) {
+			continue;
+		}
+		auto comments = ExtractComments(data);
+		if (comments.empty()) {
+			continue;
+		}
+		auto &stored = _comments[data.id];
+		if (stored != comments) {
+			stored = std::move(comments);
+			changed = true;
+		}
+	}
+	if (changed && unlocked() && !_saveTimer.isActive()) {
+		_saveTimer.callOnce(kSaveDelay);
+	}
+}
+
+void DecryptedCache::save() {
+	_saveTimer.cancel();
+	if (_path.isEmpty() || !unlocked()) {
+		return;
+	}
+	SaveFileAsync(_path, [
+		key = _key,
+		salt = _salt,
+		bytes = Serialize(_comments)
+	] {
+		auto encrypted = Encrypt(key, bytes);
+		return encrypted.isEmpty()
+			? QByteArray()
+			: SerializeStored({ salt, std::move(encrypted) });
+	});
+}
+
+void RemoveDecryptedCache(const QString &path) {
+	RemoveFileAsync(path);
+}
+
+} // namespace Wallet
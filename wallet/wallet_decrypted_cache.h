@@ -0,0 +1,64 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "ton/ton_state.h"
+#include "base/weak_ptr.h"
+#include "base/timer.h"
+#include "wallet/wallet_common.h"
+
+#include <unordered_map>
+
+namespace Wallet {
+
+// Decrypted comments kept between launches, so that they are not
+// decrypted again. The file is encrypted with a key derived from the
+// wallet passcode, so it is read only after the passcode was entered.
+class DecryptedCache final : public base::has_weak_ptr {
+public:
+	// An empty path keeps the comments in memory only.
+	explicit DecryptedCache(const QString &path);
+	~DecryptedCache();
+
+	// Derives the key once per session and reads the file with it.
+	void unlock(const QByteArray &passcode);
+	[[nodiscard]] bool unlocked() const;
+	[[nodiscard]] rpl::producer<> unlocks() const;
+
+	[[nodiscard]] bool empty() const;
+
+	// Decrypted copies of those transactions that have known comments.
+	[[nodiscard]] std::vector<Ton::Transaction> lookup(
+		const std::vector<Ton::Transaction> &list) const;
+	void store(const std::vector<Ton::Transaction> &list);
+
+private:
+	// Texts of the incoming message and then of the outgoing messages,
+	// null for the messages that were not encrypted.
+	using Comments = std::vector<QString>;
+	using Map = std::unordered_map<
+		Ton::TransactionId,
+		Comments,
+		TransactionIdHash>;
+
+	void loaded(const QByteArray &key, const QByteArray &salt, Map &&map);
+	void save();
+
+	const QString _path;
+	QByteArray _key;
+	QByteArray _salt;
+	bool _unlocking = false;
+	Map _comments;
+	base::Timer _saveTimer;
+	rpl::event_stream<> _unlocks;
+
+};
+
+// Removes the file after any save that is still being written.
+void RemoveDecryptedCache(const QString &path);
+
+} // namespace Wallet
@@ -0,0 +1,334 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "wallet/wallet_export_history.h"
+
+#include "wallet/wallet_common.h"
+#include "wallet/wallet_phrases.h"
+#include "ton/ton_account_viewer.h"
+#include "ton/ton_result.h"
+#include "ui/widgets/labels.h"
+#include "styles/style_wallet.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QDateTime>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+
+namespace Wallet {
+namespace {
+
+// Address and comment are chosen by the counterparty, a spreadsheet
+// must not evaluate them as formulas.
+[[nodiscard]] QString NeutralizeFormula(QString value) {
+	static const auto starts = QString("=+-@\t\r");
+	return (!value.isEmpty() && starts.contains(value[0]))
+		? ('\'' + value)
+		: value;
+}
+
+[[nodiscard]] QString EscapeCsv(QString value) {
+	if (value.contains(QRegularExpression("[\",\r\n]"))) {
+		value.replace('"', "\"\"");
+		return '"' + value + '"';
+	}
+	return value;
+}
+
+[[nodiscard]] QString Direction(const Ton::Transaction &data) {
+	return IsServiceTransaction(data)
+		? "service"
+		: data.outgoing.empty()
+		? "in"
+		: "out";
+}
+
+[[nodiscard]] QStringList Fields(const Ton::Transaction &data) {
+	const auto encrypted = IsEncryptedMessage(data);
+	return {
+		QString::number(data.id.lt),
+		QString::fromLatin1(data.id.hash.toBase64()),
+		QDateTime::fromSecsSinceEpoch(
+			data.time,
+			Qt::UTC).toString(Qt::ISODate),
+		Direction(data),
+		ExtractAddress(data),
+		FormatAmount(CalculateValue(data), FormatFlag::Signed).full,
+		FormatAmount(data.fee).full,
+		encrypted ? "true" : "false",
+		ExtractMessage(data),
+	};
+}
+
+[[nodiscard]] const QStringList &FieldNames() {
+	static const auto result = QStringList{
+		"lt",
+		"hash",
+		"time",
+		"direction",
+		"address",
+		"amount",
+		"fee",
+		"encrypted",
+		"comment",
+	};
+	return result;
+}
+
+[[nodiscard]] const std::vector<bool> &FreeTextFields() {
+	static const auto result = [] {
+		const auto &names = FieldNames();
+		return names | ranges::view::transform([](const QString &name) {
+			return (name == "address") || (name == "comment");
+		}) | ranges::to_vector;
+	}();
+	return result;
+}
+
+[[nodiscard]] QByteArray SerializeCsv(const Ton::Transaction &data) {
+	auto fields = Fields(data);
+	const auto &freeText = FreeTextFields();
+	for (auto i = 0, count = int(fields.size()); i != count; ++i) {
+		fields[i] = EscapeCsv(freeText[i]
+			? NeutralizeFormula(std::move(fields[i]))
+			: std::move(fields[i]));
+	}
+	return fields.join(',').toUtf8() + "\r\n";
+}
+
+[[nodiscard]] QByteArray SerializeJson(const Ton::Transaction &data) {
+	const auto fields = Fields(data);
+	const auto &names = FieldNames();
+	auto object = QJsonObject();
+	for (auto i = 0, count = int(names.size()); i != count; ++i) {
+		object.insert(names[i], fields[i]);
+	}
+	return QJsonDocument(object).toJson(QJsonDocument::Compact);
+}
+
+} // namespace
+
+class HistoryExport::Writer final {
+public:
+	Writer(const QString &path, HistoryExportFormat format);
+
+	[[nodiscard]] bool write(const std::vector<Ton::Transaction> &list);
+	[[nodiscard]] bool finish();
+	void remove();
+
+private:
+	QFile _file;
+	HistoryExportFormat _format = HistoryExportFormat::Csv;
+	bool _opened = false;
+	bool _empty = true;
+
+};
+
+HistoryExport::Writer::Writer(const QString &path, HistoryExportFormat format)
+: _file(path)
+, _format(format) {
+	_opened = _file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+	if (!_opened) {
+		return;
+	}
+	const auto header = (_format == HistoryExportFormat::Csv)
+		? (FieldNames().join(',').toUtf8() + "\r\n")
+		: QByteArray("[");
+	_opened = (_file.write(header) == header.size());
+}
+
+bool HistoryExport::Writer::write(const std::vector<Ton::Transaction> &list) {
+	if (!_opened) {
+		return false;
+	}
+	auto chunk = QByteArray();
+	for (const auto &data : list) {
+		if (_format == HistoryExportFormat::Csv) {
+			chunk.append(SerializeCsv(data));
+		} else {
+			chunk.append(_empty ? "\n" : ",\n");
+			chunk.append(SerializeJson(data));
+		}
+		_empty = false;
+	}
+	return (_file.write(chunk) == chunk.size());
+}
+
+bool HistoryExport::Writer::finish() {
+	if (!_opened) {
+		return false;
+	} else if (_format == HistoryExportFormat::Json) {
+		const auto footer = QByteArray(_empty ? "]\n" : "\n]\n");
+		if (_file.write(footer) != footer.size()) {
+			return false;
+		}
+	}
+	_file.close();
+	return (_file.error() == QFileDevice::NoError);
+}
+
+void HistoryExport::Writer::remove() {
+	_file.remove();
+}
+
+HistoryExportFormat HistoryExportFormatFromPath(const QString &path) {
+	return path.endsWith(".json", Qt::CaseInsensitive)
+		? HistoryExportFormat::Json
+		: HistoryExportFormat::Csv;
+}
+
+HistoryExport::HistoryExport(
+	std::unique_ptr<Ton::AccountViewer> viewer,
+	Ton::TransactionsSlice first,
+	const QString &path,
+	HistoryExportFormat format)
+: _viewer(std::move(viewer))
+, _writer(path, format)
+, _previousId(first.previousId) {
+	_viewer->loaded(
+	) | rpl::filter([=](const Ton::Result<Ton::LoadedSlice> &value) {
+		return !value || (value->after == _previousId);
+	}) | rpl::start_with_next([=](Ton::Result<Ton::LoadedSlice> &&value) {
+		if (!value) {
+			fail();
+			return;
+		}
+		_previousId = value->data.previousId;
+		write(std::move(value->data.list));
+	}, _lifetime);
+
+	write(std::move(first.list));
+}
+
+HistoryExport::~HistoryExport() {
+	cancel();
+}
+
+rpl::producer<int> HistoryExport::exportedValue() const {
+	return _exported.value();
+}
+
+rpl::producer<> HistoryExport::finished() const {
+	return _finished.events();
+}
+
+rpl::producer<> HistoryExport::failed() const {
+	return _failed.events();
+}
+
+void HistoryExport::cancel() {
+	if (std::exchange(_done, true)) {
+		return;
+	}
+	_lifetime.destroy();
+	_writer.with([](Writer &writer) {
+		writer.remove();
+	});
+}
+
+void HistoryExport::write(std::vector<Ton::Transaction> &&list) {
+	const auto weak = base::make_weak(this);
+	_writer.with([=, list = std::move(list)](Writer &writer) {
+		const auto ok = writer.write(list);
+		crl::on_main(weak, [=, count = int(list.size())] {
+			written(count, ok);
+		});
+	});
+}
+
+void HistoryExport::written(int count, bool ok) {
+	if (_done) {
+		return;
+	} else if (!ok) {
+		fail();
+		return;
+	}
+	_exported = _exported.current() + count;
+	if (_previousId.lt) {
+		requestNext();
+	} else {
+		finish();
+	}
+}
+
+void HistoryExport::requestNext() {
+	_viewer->preloadSlice(_previousId);
+}
+
+void HistoryExport::finish() {
+	const auto weak = base::make_weak(this);
+	_writer.with([=](Writer &writer) {
+		const auto ok = writer.finish();
+		crl::on_main(weak, [=] {
+			if (_done) {
+				return;
+			} else if (!ok) {
+				fail();
+				return;
+			}
+			_done = true;
+			_lifetime.destroy();
+			_finished.fire({});
+		});
+	});
+}
+
+void HistoryExport::fail() {
+	cancel();
+	_failed.fire({});
+}
+
+void HistoryExportBox(
+		not_null<Ui::GenericBox*> box,
+		std::shared_ptr<HistoryExport> exporter) {
+	const auto raw = exporter.get();
+	box->lifetime().add([exporter] {
+		exporter->cancel();
+	});
+
+	box->setTitle(ph::lng_wallet_export_history_title());
+	box->setCloseByOutsideClick(false);
+
+	const auto status = box->lifetime().make_state<
+		rpl::variable<QString>>();
+	*status = raw->exportedValue(
+	) | rpl::map([](int count) {
+		return ph::lng_wallet_export_history_progress(ph::now).replace(
+			"{count}",
+			QString::number(count));
+	});
+	box->addRow(object_ptr<Ui::FlatLabel>(
+		box,
+		status->value(),
+		st::walletLabel));
+	box->addButton(ph::lng_wallet_cancel(), [=] {
+		box->closeBox();
+	});
+
+	const auto showResult = [=](rpl::producer<QString> text) {
+		*status = std::move(text);
+		box->clearButtons();
+		box->addButton(ph::lng_wallet_done(), [=] {
+			box->closeBox();
+		});
+	};
+	raw->finished(
+	) | rpl::start_with_next([=] {
+		showResult(raw->exportedValue(
+		) | rpl::map([](int count) {
+			return ph::lng_wallet_export_history_done(ph::now).replace(
+				"{count}",
+				QString::number(count));
+		}));
+	}, box->lifetime());
+	raw->failed(
+	) | rpl::start_with_next([=] {
+		showResult(ph::lng_wallet_export_history_failed());
+	}, box->lifetime());
+}
+
+} // namespace Wallet
@@ -0,0 +1,73 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "ton/ton_state.h"
+#include "ui/layers/generic_box.h"
+#include "base/weak_ptr.h"
+
+#include <crl/crl_object_on_queue.h>
+
+namespace Ton {
+class AccountViewer;
+} // namespace Ton
+
+namespace Wallet {
+
+enum class HistoryExportFormat {
+	Csv,
+	Json,
+};
+
+[[nodiscard]] HistoryExportFormat HistoryExportFormatFromPath(
+	const QString &path);
+
+// Pages through the whole account history slice by slice and writes
+// the transactions to a file on a background queue. The next slice is
+// requested only after the previous one was written, so memory use
+// doesn't depend on the history length.
+class HistoryExport final : public base::has_weak_ptr {
+public:
+	HistoryExport(
+		std::unique_ptr<Ton::AccountViewer> viewer,
+		Ton::TransactionsSlice first,
+		const QString &path,
+		HistoryExportFormat format);
+	~HistoryExport();
+
+	[[nodiscard]] rpl::producer<int> exportedValue() const;
+	[[nodiscard]] rpl::producer<> finished() const;
+	[[nodiscard]] rpl::producer<> failed() const;
+
+	// Stops paging and removes the partially written file.
+	void cancel();
+
+private:
+	class Writer;
+
+	void write(std::vector<Ton::Transaction> &&list);
+	void written(int count, bool ok);
+	void requestNext();
+	void finish();
+	void fail();
+
+	std::unique_ptr<Ton::AccountViewer> _viewer;
+	crl::object_on_queue<Writer> _writer;
+	Ton::TransactionId _previousId;
+	rpl::variable<int> _exported = 0;
+	rpl::event_stream<> _finished;
+	rpl::event_stream<> _failed;
+	bool _done = false;
+	rpl::lifetime _lifetime;
+
+};
+
+void HistoryExportBox(
+	not_null<Ui::GenericBox*> box,
+	std::shared_ptr<HistoryExport> exporter);
+
+} // namespace Wallet
@@ -8,6 +8,7 @@
 
 #include "wallet/wallet_common.h"
 #include "wallet/wallet_phrases.h"
+#include "wallet/wallet_log.h"
 #include "base/unixtime.h"
 #include "base/flags.h"
 #include "ui/address_label.h"
@@ -15,7 +16,6 @@
 #include "ui/painter.h"
 #include "ui/text/text.h"
 #include "ui/text/text_utilities.h"
-#include "ui/effects/animations.h"
 #include "styles/style_wallet.h"
 #include "styles/palette.h"
 
@@ -24,8 +24,23 @@
 namespace Wallet {
 namespace {
 
-constexpr auto kPreloadScreens = 3;
+constexpr auto kPreloadScreensMin = 1;
+constexpr auto kPreloadScreensMax = 8;
+constexpr auto kPreloadLatencyDefault = crl::time(500);
+constexpr auto kPreloadRetryTimeout = crl::time(10000);
+constexpr auto kScrollVelocityTimeout = crl::time(200);
 constexpr auto kCommentLinesMax = 3;
+constexpr auto kRowsCacheBytesMax = 32 * 1024 * 1024;
+constexpr auto kResidentRowsMax = 2000;
+constexpr auto kResidentRowsAfterEviction = 1500;
+constexpr auto kHitTestInterval = crl::time(16);
+constexpr auto kRelayoutSettleDelay = crl::time(300);
+constexpr auto kRelayoutStepDelay = crl::time(16);
+constexpr auto kRelayoutStepsPerScreen = 2;
+
+// Rows farther than this many screens from the viewport
+// keep only an estimated height without any text layouts.
+constexpr auto kLayoutBandScreens = 2;
 
 enum class Flag : uchar {
 	Incoming = 0x01,
@@ -38,18 +53,14 @@ inline constexpr bool is_flag_type(Flag) { return true; };
 using Flags = base::flags<Flag>;
 
 struct TransactionLayout {
-	TimeId serverTime = 0;
-	QDateTime dateTime;
-	Ui::Text::String date;
-	Ui::Text::String time;
 	Ui::Text::String amountGrams;
 	Ui::Text::String amountNano;
 	Ui::Text::String address;
 	Ui::Text::String comment;
 	Ui::Text::String fees;
+	Ui::Text::String balance;
 	int addressWidth = 0;
 	int addressHeight = 0;
-	Flags flags = Flags();
 };
 
 [[nodiscard]] const style::TextStyle &AddressStyle() {
@@ -57,45 +68,44 @@ struct TransactionLayout {
 	return result;
 }
 
-void RefreshTimeTexts(
-		TransactionLayout &layout,
-		bool forceDateText = false) {
-	layout.dateTime = base::unixtime::parse(layout.serverTime);
-	layout.time.setText(
-		st::defaultTextStyle,
-		ph::lng_wallet_short_time(layout.dateTime.time())(ph::now));
-	if (layout.date.isEmpty() && !forceDateText) {
-		return;
-	}
-	if (layout.flags & Flag::Pending) {
-		layout.date.setText(
-			st::semiboldTextStyle,
-			ph::lng_wallet_row_pending_date(ph::now));
-	} else {
-		layout.date.setText(
-			st::semiboldTextStyle,
-			ph::lng_wallet_short_date(layout.dateTime.date())(ph::now));
-	}
+[[nodiscard]] Flags ComputeFlags(
+		const Ton::Transaction &data,
+		bool decryptable,
+		bool isInitTransaction) {
+	const auto service = IsServiceTransaction(data);
+	const auto encrypted = IsEncryptedMessage(data) && decryptable;
+	const auto incoming = !data.incoming.source.isEmpty();
+	const auto pending = (data.id.lt == 0);
+	return Flag(0)
+		| (service ? Flag::Service : Flag(0))
+		| (isInitTransaction ? Flag::Initialization : Flag(0))
+		| (encrypted ? Flag::Encrypted : Flag(0))
+		| (incoming ? Flag::Incoming : Flag(0))
+		| (pending ? Flag::Pending : Flag(0));
+}
+
+[[nodiscard]] bool IsDecryptedMessage(const Ton::Transaction &data) {
+	const auto &message = data.outgoing.empty()
+		? data.incoming.message
+		: data.outgoing.front().message;
+	return message.decrypted;
 }
 
 [[nodiscard]] TransactionLayout PrepareLayout(
 		const Ton::Transaction &data,
-		Fn<void()> decrypt,
-		bool isInitTransaction) {
-	const auto service = IsServiceTransaction(data);
-	const auto encrypted = IsEncryptedMessage(data) && decrypt;
+		Flags flags,
+		std::optional<int64> balance) {
+	const auto service = (flags & Flag::Service);
+	const auto encrypted = (flags & Flag::Encrypted);
 	const auto amount = FormatAmount(
 		service ? (-data.fee) : CalculateValue(data),
 		FormatFlag::Signed | FormatFlag::Rounded);
-	const auto incoming = !data.incoming.source.isEmpty();
-	const auto pending = (data.id.lt == 0);
 	const auto address = ExtractAddress(data);
 	const auto addressPartWidth = [&](int from, int length = -1) {
 		return AddressStyle().font->width(address.mid(from, length));
 	};
 
 	auto result = TransactionLayout();
-	result.serverTime = data.time;
 	result.amountGrams.setText(st::walletRowGramsStyle, amount.gramsString);
 	result.amountNano.setText(
 		st::walletRowNanoStyle,
@@ -120,14 +130,12 @@ void RefreshTimeTexts(
 			st::defaultTextStyle,
 			ph::lng_wallet_row_fees(ph::now).replace("{amount}", fee));
 	}
-	result.flags = Flag(0)
-		| (service ? Flag::Service : Flag(0))
-		| (isInitTransaction ? Flag::Initialization : Flag(0))
-		| (encrypted ? Flag::Encrypted : Flag(0))
-		| (incoming ? Flag::Incoming : Flag(0))
-		| (pending ? Flag::Pending : Flag(0));
-
-	RefreshTimeTexts(result);
+	if (balance) {
+		const auto amount = FormatAmount(*balance).full;
+		result.balance.setText(
+			st::defaultTextStyle,
+			ph::lng_wallet_row_balance(ph::now).replace("{amount}", amount));
+	}
 	return result;
 }
 
@@ -144,37 +152,73 @@ public:
 
 	[[nodiscard]] Ton::TransactionId id() const;
 
-	void refreshDate();
+	// Text layouts are built only for rows near the viewport,
+	// all the other rows use an estimated height until prepared.
+	void prepare(
+		const Ton::Transaction &transaction,
+		std::optional<int64> balance = std::nullopt);
+	void unprepare();
+
+	// Returns true if the day of the row has changed.
+	bool refreshDate();
+	void markDateStale();
+	[[nodiscard]] bool dateStale() const;
 	[[nodiscard]] QDateTime date() const;
-	void setShowDate(bool show, Fn<void()> repaintDate);
+	[[nodiscard]] bool pending() const;
+	void setShowDate(bool show);
+	void setShowBalance(bool show);
 	void setDecryptionFailed();
 	bool showDate() const;
 
-	[[nodiscard]] int top() const;
-	void setTop(int top);
-
 	void resizeToWidth(int width);
 	[[nodiscard]] int height() const;
-	[[nodiscard]] int bottom() const;
 
-	void paint(Painter &p, int x, int y);
-	void paintDate(Painter &p, int x, int y);
+	// Time and date labels are shared by the rows, History owns them.
+	void paint(Painter &p, int x, int y, const Ui::Text::String &time);
+
+	// Returns true if the cached image was rendered during this call.
+	bool paintCached(
+		Painter &p,
+		int x,
+		int y,
+		const Ui::Text::String &time);
+	void clearCache();
+	[[nodiscard]] int cacheBytes() const;
+
+	// The day total is drawn on the right, if there is one.
+	void paintDate(
+		Painter &p,
+		int x,
+		int y,
+		const Ui::Text::String &date,
+		const Ui::Text::String *total,
+		bool totalPositive,
+		float64 shadowOpacity);
+
+	// The point is in row coordinates.
 	[[nodiscard]] bool isUnderCursor(QPoint point) const;
 	[[nodiscard]] ClickHandlerPtr handlerUnderCursor(QPoint point) const;
 
 private:
 	[[nodiscard]] QRect computeInnerRect() const;
+	[[nodiscard]] int countEstimatedHeight() const;
+	void refreshDecryptionFailedText();
 
 	Ton::TransactionId _id;
-	TransactionLayout _layout;
-	int _top = 0;
+	TimeId _serverTime = 0;
+	QDateTime _dateTime;
+	std::unique_ptr<TransactionLayout> _layout;
+	QImage _cache;
+	Flags _flags = Flags();
+	bool _hasComment = false;
+	bool _hasFees = false;
+	bool _showBalance = false;
+	bool _showDate = false;
 	int _width = 0;
 	int _height = 0;
 	int _commentHeight = 0;
 
-	Ui::Animations::Simple _dateShadowShown;
-	Fn<void()> _repaintDate;
-	bool _dateHasShadow = false;
+	bool _dateStale = false;
 	bool _decryptionFailed = false;
 
 };
@@ -184,50 +228,99 @@ HistoryRow::HistoryRow(
 	Fn<void()> decrypt,
 	bool isInitTransaction)
 : _id(transaction.id)
-, _layout(PrepareLayout(transaction, decrypt, isInitTransaction)) {
+, _serverTime(transaction.time)
+, _dateTime(base::unixtime::parse(_serverTime))
+, _flags(ComputeFlags(transaction, decrypt != nullptr, isInitTransaction))
+, _hasComment(!(_flags & Flag::Encrypted)
+	&& !ExtractMessage(transaction).isEmpty())
+, _hasFees(transaction.fee != 0) {
 }
 
 Ton::TransactionId HistoryRow::id() const {
 	return _id;
 }
 
-void HistoryRow::refreshDate() {
-	RefreshTimeTexts(_layout);
+void HistoryRow::prepare(
+		const Ton::Transaction &transaction,
+		std::optional<int64> balance) {
+	Expects(transaction.id == _id);
+
+	_layout = std::make_unique<TransactionLayout>(PrepareLayout(
+		transaction,
+		_flags,
+		_showBalance ? balance : std::nullopt));
+	if (_decryptionFailed) {
+		refreshDecryptionFailedText();
+	}
+	_width = 0;
+	clearCache();
+}
+
+void HistoryRow::unprepare() {
+	// Keep the last exact height, it stays valid until the width changes.
+	_layout = nullptr;
+	clearCache();
+}
+
+bool HistoryRow::refreshDate() {
+	const auto was = _dateTime.date();
+	_dateStale = false;
+	_dateTime = base::unixtime::parse(_serverTime);
+	clearCache();
+	return (_dateTime.date() != was);
+}
+
+void HistoryRow::markDateStale() {
+	_dateStale = true;
+}
+
+bool HistoryRow::dateStale() const {
+	return _dateStale;
 }
 
 QDateTime HistoryRow::date() const {
-	return _layout.dateTime;
+	return _dateTime;
+}
+
+bool HistoryRow::pending() const {
+	return (_flags & Flag::Pending);
 }
 
-void HistoryRow::setShowDate(bool show, Fn<void()> repaintDate) {
+void HistoryRow::setShowDate(bool show) {
 	_width = 0;
-	if (!show) {
-		_layout.date.clear();
-	} else {
-		_repaintDate = std::move(repaintDate);
-		RefreshTimeTexts(_layout, true);
+	clearCache();
+	_showDate = show;
+}
+
+void HistoryRow::setShowBalance(bool show) {
+	if (_showBalance != show) {
+		_showBalance = show;
+		_width = 0;
+		clearCache();
 	}
 }
 
 void HistoryRow::setDecryptionFailed() {
 	_width = 0;
+	clearCache();
 	_decryptionFailed = true;
-	_layout.comment.setText(
+	_hasComment = true;
+	if (_layout) {
+		refreshDecryptionFailedText();
+	}
+}
+
+void HistoryRow::refreshDecryptionFailedText() {
+	Expects(_layout != nullptr);
+
+	_layout->comment.setText(
 		st::defaultTextStyle,
 		ph::lng_wallet_decrypt_failed(ph::now),
 		_textPlainOptions);
 }
 
 bool HistoryRow::showDate() const {
-	return !_layout.date.isEmpty();
-}
-
-int HistoryRow::top() const {
-	return _top;
-}
-
-void HistoryRow::setTop(int top) {
-	_top = top;
+	return _showDate;
 }
 
 void HistoryRow::resizeToWidth(int width) {
@@ -235,44 +328,78 @@ void HistoryRow::resizeToWidth(int width) {
 		return;
 	}
 	_width = width;
+	clearCache();
+	if (!_layout) {
+		_height = countEstimatedHeight();
+		return;
+	}
 	const auto padding = st::walletRowPadding;
 	const auto use = std::min(_width, st::walletRowWidthMax);
 	const auto avail = use - padding.left() - padding.right();
 	_height = 0;
-	if (!_layout.date.isEmpty()) {
+	if (_showDate) {
 		_height += st::walletRowDateSkip;
 	}
-	_height += padding.top() + _layout.amountGrams.minHeight();
-	if (!_layout.address.isEmpty()) {
-		_height += st::walletRowAddressTop + _layout.addressHeight;
+	_height += padding.top() + _layout->amountGrams.minHeight();
+	if (!_layout->address.isEmpty()) {
+		_height += st::walletRowAddressTop + _layout->addressHeight;
 	}
-	if (!_layout.comment.isEmpty()) {
+	if (!_layout->comment.isEmpty()) {
 		_commentHeight = std::min(
-			_layout.comment.countHeight(avail),
+			_layout->comment.countHeight(avail),
 			st::defaultTextStyle.font->height * kCommentLinesMax);
 		_height += st::walletRowCommentTop + _commentHeight;
 	}
-	if (!_layout.fees.isEmpty()) {
-		_height += st::walletRowFeesTop + _layout.fees.minHeight();
+	if (!_layout->fees.isEmpty()) {
+		_height += st::walletRowFeesTop + _layout->fees.minHeight();
+	}
+	if (!_layout->balance.isEmpty()) {
+		_height += st::walletRowFeesTop + _layout->balance.minHeight();
 	}
 	_height += padding.bottom();
 }
 
-int HistoryRow::height() const {
-	return _height;
+int HistoryRow::countEstimatedHeight() const {
+	const auto padding = st::walletRowPadding;
+	auto result = padding.top()
+		+ st::walletRowGramsStyle.font->height
+		+ padding.bottom();
+	if (_showDate) {
+		result += st::walletRowDateSkip;
+	}
+	if (!(_flags & Flag::Service)) {
+		result += st::walletRowAddressTop + AddressStyle().font->height * 2;
+	}
+	if (_hasComment) {
+		result += st::walletRowCommentTop + st::defaultTextStyle.font->height;
+	}
+	if (_hasFees) {
+		result += st::walletRowFeesTop + st::defaultTextStyle.font->height;
+	}
+	if (_showBalance && !(_flags & Flag::Pending)) {
+		result += st::walletRowFeesTop + st::defaultTextStyle.font->height;
+	}
+	return result;
 }
 
-int HistoryRow::bottom() const {
-	return _top + _height;
+int HistoryRow::height() const {
+	return _height;
 }
 
-void HistoryRow::paint(Painter &p, int x, int y) {
+void HistoryRow::paint(
+		Painter &p,
+		int x,
+		int y,
+		const Ui::Text::String &time) {
+	if (!_layout) {
+		return;
+	}
 	const auto padding = st::walletRowPadding;
 	const auto use = std::min(_width, st::walletRowWidthMax);
 	const auto avail = use - padding.left() - padding.right();
 	x += (_width - use) / 2 + padding.left();
 
-	if (!_layout.date.isEmpty()) {
+	if (_showDate) {
 		y += st::walletRowDateSkip;
 	} else {
 		const auto shadowLeft = (use < _width)
@@ -285,7 +412,7 @@ void HistoryRow::paint(Painter &p, int x, int y) {
 	}
 	y += padding.top();
 
-	if (_layout.flags & Flag::Service) {
+	if (_flags & Flag::Service) {
 		const auto labelLeft = x;
 		const auto labelTop = y
 			+ st::walletRowGramsStyle.font->ascent
@@ -295,25 +422,25 @@ void HistoryRow::paint(Painter &p, int x, int y) {
 		p.drawText(
 			labelLeft,
 			labelTop + st::normalFont->ascent,
-			((_layout.flags & Flag::Initialization)
+			((_flags & Flag::Initialization)
 				? ph::lng_wallet_row_init(ph::now)
 				: ph::lng_wallet_row_service(ph::now)));
 	} else {
-		const auto incoming = (_layout.flags & Flag::Incoming);
+		const auto incoming = (_flags & Flag::Incoming);
 		p.setPen(incoming ? st::boxTextFgGood : st::boxTextFgError);
-		_layout.amountGrams.draw(p, x, y, avail);
+		_layout->amountGrams.draw(p, x, y, avail);
 
 		const auto nanoTop = y
 			+ st::walletRowGramsStyle.font->ascent
 			- st::walletRowNanoStyle.font->ascent;
-		const auto nanoLeft = x + _layout.amountGrams.maxWidth();
-		_layout.amountNano.draw(p, nanoLeft, nanoTop, avail);
+		const auto nanoLeft = x + _layout->amountGrams.maxWidth();
+		_layout->amountNano.draw(p, nanoLeft, nanoTop, avail);
 
 		const auto diamondTop = y
 			+ st::walletRowGramsStyle.font->ascent
 			- st::normalFont->ascent;
 		const auto diamondLeft = nanoLeft
-			+ _layout.amountNano.maxWidth()
+			+ _layout->amountNano.maxWidth()
 			+ st::normalFont->spacew;
 		Ui::PaintInlineDiamond(p, diamondLeft, diamondTop, st::normalFont);
 
@@ -331,10 +458,10 @@ void HistoryRow::paint(Painter &p, int x, int y) {
 				: ph::lng_wallet_row_to(ph::now)));
 
 		const auto timeTop = labelTop;
-		const auto timeLeft = x + avail - _layout.time.maxWidth();
+		const auto timeLeft = x + avail - time.maxWidth();
 		p.setPen(st::windowSubTextFg);
-		_layout.time.draw(p, timeLeft, timeTop, avail);
-		if (_layout.flags & Flag::Encrypted) {
+		time.draw(p, timeLeft, timeTop, avail);
+		if (_flags & Flag::Encrypted) {
 			const auto iconLeft = x
 				+ avail
 				- st::walletCommentIconLeft
@@ -342,7 +469,7 @@ void HistoryRow::paint(Painter &p, int x, int y) {
 			const auto iconTop = labelTop + st::walletCommentIconTop;
 			st::walletCommentIcon.paint(p, iconLeft, iconTop, avail);
 		}
-		if (_layout.flags & Flag::Pending) {
+		if (_flags & Flag::Pending) {
 			st::walletRowPending.paint(
 				p,
 				(timeLeft
@@ -352,57 +479,93 @@ void HistoryRow::paint(Painter &p, int x, int y) {
 				avail);
 		}
 	}
-	y += _layout.amountGrams.minHeight();
+	y += _layout->amountGrams.minHeight();
 
-	if (!_layout.address.isEmpty()) {
+	if (!_layout->address.isEmpty()) {
 		p.setPen(st::windowFg);
 		y += st::walletRowAddressTop;
-		_layout.address.drawElided(
+		_layout->address.drawElided(
 			p,
 			x,
 			y,
-			_layout.addressWidth,
+			_layout->addressWidth,
 			2,
 			style::al_topleft,
 			0,
 			-1,
 			0,
 			true);
-		y += _layout.addressHeight;
+		y += _layout->addressHeight;
 	}
-	if (!_layout.comment.isEmpty()) {
+	if (!_layout->comment.isEmpty()) {
 		y += st::walletRowCommentTop;
 		if (_decryptionFailed) {
 			p.setPen(st::boxTextFgError);
 		}
-		_layout.comment.drawElided(p, x, y, avail, kCommentLinesMax);
+		_layout->comment.drawElided(p, x, y, avail, kCommentLinesMax);
 		y += _commentHeight;
 	}
-	if (!_layout.fees.isEmpty()) {
+	if (!_layout->fees.isEmpty()) {
 		p.setPen(st::windowSubTextFg);
 		y += st::walletRowFeesTop;
-		_layout.fees.draw(p, x, y, avail);
+		_layout->fees.draw(p, x, y, avail);
+		y += _layout->fees.minHeight();
+	}
+	if (!_layout->balance.isEmpty()) {
+		p.setPen(st::windowSubTextFg);
+		y += st::walletRowFeesTop;
+		_layout->balance.draw(p, x, y, avail);
 	}
 }
 
-void HistoryRow::paintDate(Painter &p, int x, int y) {
-	Expects(!_layout.date.isEmpty());
-	Expects(_repaintDate != nullptr);
-
-	const auto hasShadow = (y != top());
-	if (_dateHasShadow != hasShadow) {
-		_dateHasShadow = hasShadow;
-		_dateShadowShown.start(
-			_repaintDate,
-			hasShadow ? 0. : 1.,
-			hasShadow ? 1. : 0.,
-			st::widgetFadeDuration);
+bool HistoryRow::paintCached(
+		Painter &p,
+		int x,
+		int y,
+		const Ui::Text::String &time) {
+	if (!_layout || _width <= 0 || _height <= 0) {
+		return false;
 	}
+	// Rendered again after the device pixel ratio changes.
+	const auto pixelRatio = style::DevicePixelRatio();
+	const auto rendered = _cache.isNull()
+		|| (_cache.devicePixelRatio() != pixelRatio);
+	if (rendered) {
+		_cache = QImage(
+			QSize(_width, _height) * pixelRatio,
+			QImage::Format_ARGB32_Premultiplied);
+		_cache.setDevicePixelRatio(pixelRatio);
+		_cache.fill(st::windowBg->c);
+		Painter q(&_cache);
+		paint(q, 0, 0, time);
+	}
+	p.drawImage(x, y, _cache);
+	return rendered;
+}
+
+void HistoryRow::clearCache() {
+	_cache = QImage();
+}
+
+int HistoryRow::cacheBytes() const {
+	return _cache.isNull() ? 0 : int(_cache.sizeInBytes());
+}
+
+void HistoryRow::paintDate(
+		Painter &p,
+		int x,
+		int y,
+		const Ui::Text::String &date,
+		const Ui::Text::String *total,
+		bool totalPositive,
+		float64 shadowOpacity) {
+	Expects(_showDate);
+
 	const auto line = st::lineWidth;
 	const auto noShadowHeight = st::walletRowDateHeight - line;
 
-	if (_dateHasShadow || _dateShadowShown.animating()) {
-		p.setOpacity(_dateShadowShown.value(_dateHasShadow ? 1. : 0.));
+	if (shadowOpacity > 0.) {
+		p.setOpacity(shadowOpacity);
 		p.fillRect(x, y + noShadowHeight, _width, line, st::shadowFg);
 	}
 
@@ -417,7 +580,17 @@ void HistoryRow::paintDate(Painter &p, int x, int y) {
 	x += padding.left();
 	p.setOpacity(1.);
 	p.setPen(st::windowFg);
-	_layout.date.draw(p, x, y + st::walletRowDateTop, avail);
+	date.draw(p, x, y + st::walletRowDateTop, avail);
+
+	if (!total) {
+		return;
+	}
+	p.setPen(totalPositive ? st::boxTextFgGood : st::boxTextFgError);
+	total->draw(
+		p,
+		x + avail - total->maxWidth(),
+		y + st::walletRowDateTop,
+		avail);
 }
 
 QRect HistoryRow::computeInnerRect() const {
@@ -430,11 +603,8 @@ QRect HistoryRow::computeInnerRect() const {
 	const auto width = (use < _width)
 		? (avail + 2 * st::walletRowShadowAdd)
 		: _width;
-	auto y = top();
-	if (!_layout.date.isEmpty()) {
-		y += st::walletRowDateSkip;
-	}
-	return QRect(left, y, width, bottom() - y);
+	const auto y = _showDate ? st::walletRowDateSkip : 0;
+	return QRect(left, y, width, _height - y);
 }
 
 bool HistoryRow::isUnderCursor(QPoint point) const {
@@ -449,29 +619,41 @@ History::History(
 	not_null<Ui::RpWidget*> parent,
 	rpl::producer<HistoryState> state,
 	rpl::producer<Ton::LoadedSlice> loaded,
-	rpl::producer<not_null<std::vector<Ton::Transaction>*>> collectEncrypted,
+	rpl::producer<not_null<CollectedEncrypted*>> collectEncrypted,
 	rpl::producer<
 		not_null<const std::vector<Ton::Transaction>*>> updateDecrypted)
-: _widget(parent) {
+: _widget(parent)
+, _relayoutTimer([=] { relayoutStep(); })
+, _selectByMouseTimer([=] { selectRowByMouse(); }) {
 	setupContent(std::move(state), std::move(loaded));
 
 	base::unixtime::updates(
 	) | rpl::start_with_next([=] {
-		for (const auto &row : ranges::view::concat(_pendingRows, _rows)) {
+		for (const auto &row : _pendingRows) {
 			row->refreshDate();
 		}
-		refreshShowDates();
+		for (const auto &row : _rows) {
+			row->markDateStale();
+		}
+		refreshStaleDates(_preparedFrom, _preparedTill);
+		refreshHeight();
 		_widget.update();
 	}, _widget.lifetime());
 
+	style::PaletteChanged(
+	) | rpl::start_with_next([=] {
+		clearRowsCache();
+	}, _widget.lifetime());
+
+	PhrasesUpdated(
+	) | rpl::start_with_next([=] {
+		refreshTexts();
+	}, _widget.lifetime());
+
 	std::move(
 		collectEncrypted
-	) | rpl::start_with_next([=](
-			not_null<std::vector<Ton::Transaction>*> list) {
-		auto &&encrypted = ranges::view::all(
-			_listData
-		) | ranges::view::filter(IsEncryptedMessage);
-		list->insert(list->end(), encrypted.begin(), encrypted.end());
+	) | rpl::start_with_next([=](not_null<CollectedEncrypted*> collected) {
+		collectEncryptedRows(collected);
 	}, _widget.lifetime());
 
 	std::move(
@@ -479,15 +661,14 @@ History::History(
 	) | rpl::start_with_next([=](
 			not_null<const std::vector<Ton::Transaction>*> list) {
 		auto changed = false;
-		for (auto i = 0, count = int(_listData.size()); i != count; ++i) {
-			if (IsEncryptedMessage(_listData[i])) {
-				if (takeDecrypted(i, *list)) {
-					changed = true;
-				}
+		for (const auto &decrypted : *list) {
+			if (takeDecrypted(decrypted)) {
+				changed = true;
 			}
 		}
 		if (changed) {
-			refreshShowDates();
+			refreshPreparedRange();
+			refreshHeight();
 			_widget.update();
 		}
 	}, _widget.lifetime());
@@ -500,22 +681,237 @@ void History::updateGeometry(QPoint position, int width) {
 	resizeToWidth(width);
 }
 
+void History::setRowsCacheEnabled(bool enabled) {
+	if (_rowsCacheEnabled == enabled) {
+		return;
+	}
+	_rowsCacheEnabled = enabled;
+	if (!enabled) {
+		clearRowsCache();
+	}
+	_widget.update();
+}
+
+void History::setShowBalances(bool show) {
+	if (_showBalances == show) {
+		return;
+	}
+	_showBalances = show;
+	for (auto i = _preparedFrom; i != _preparedTill; ++i) {
+		unprepareRow(i);
+	}
+	for (const auto &row : _rows) {
+		row->setShowBalance(show);
+	}
+	_preparedFrom = _preparedTill = 0;
+	resizeToWidth(_widget.width());
+	_widget.update();
+}
+
+void History::applyBalance(int64 balance) {
+	if (!_totals.setBalance(balance) || !_showBalances) {
+		return;
+	}
+	for (auto i = _preparedFrom; i != _preparedTill; ++i) {
+		if (_rowFlags[i] & RowFlag::Prepared) {
+			prepareRow(i);
+			refreshRowHeight(i);
+		}
+	}
+	refreshHeight();
+	_widget.update();
+}
+
+void History::clearRowsCache() {
+	for (auto i = _preparedFrom; i != _preparedTill; ++i) {
+		_rows[i]->clearCache();
+	}
+	for (const auto &row : _pendingRows) {
+		row->clearCache();
+	}
+}
+
+void History::applyRowsCacheLimit() {
+	auto bytes = 0;
+	for (const auto &row : _pendingRows) {
+		bytes += row->cacheBytes();
+	}
+	for (auto i = _preparedFrom; i != _preparedTill; ++i) {
+		bytes += _rows[i]->cacheBytes();
+	}
+	if (bytes <= kRowsCacheBytesMax) {
+		return;
+	}
+	// Pending rows are above all the others, hidden ones go first.
+	const auto count = int(_pendingRows.size());
+	for (auto i = 0; i != count && bytes > kRowsCacheBytesMax; ++i) {
+		const auto pendingTop = st::walletRowsSkip + _pendingHeights.top(i);
+		const auto pendingBottom = pendingTop + _pendingHeights.height(i);
+		if (pendingBottom <= _visibleTop || pendingTop >= _visibleBottom) {
+			bytes -= _pendingRows[i]->cacheBytes();
+			_pendingRows[i]->clearCache();
+		}
+	}
+
+	// Drop the images of the rows farthest from the viewport first.
+	const auto top = rowsTop();
+	const auto from = _heights.findByBottom(_visibleTop - top);
+	const auto till = _heights.findByTop(_visibleBottom - top);
+	auto above = _preparedFrom;
+	auto below = _preparedTill;
+	while (bytes > kRowsCacheBytesMax && (above < from || below > till)) {
+		const auto index = ((from - above) >= (below - till))
+			? above++
+			: --below;
+		bytes -= _rows[index]->cacheBytes();
+		_rows[index]->clearCache();
+	}
+}
+
 void History::resizeToWidth(int width) {
 	if (!width) {
 		return;
+	} else if (_widget.width() && _widget.width() != width) {
+		// While the window is being resized only the visible rows are
+		// laid out exactly, the band is prepared again after it settles.
+		_preparedBandHeight = 0;
+		_relayoutTimer.callOnce(kRelayoutSettleDelay);
+		refreshPreparedRange();
+	}
+	keepScrollAnchor([&] {
+		layoutRows(width);
+		refreshPreparedRange();
+	});
+}
+
+void History::relayoutStep() {
+	const auto visibleHeight = (_visibleBottom - _visibleTop);
+	const auto bandHeight = kLayoutBandScreens * visibleHeight;
+	if (_preparedBandHeight < 0) {
+		return;
+	} else if (visibleHeight <= 0) {
+		_preparedBandHeight = -1;
+		return;
+	}
+	_preparedBandHeight += std::max(visibleHeight / kRelayoutStepsPerScreen, 1);
+	if (_preparedBandHeight >= bandHeight) {
+		_preparedBandHeight = -1;
+	} else {
+		_relayoutTimer.callOnce(kRelayoutStepDelay);
+	}
+	keepScrollAnchor([&] {
+		refreshPreparedRange();
+	});
+	_widget.update();
+}
+
+void History::keepScrollAnchor(FnMut<void()> change) {
+	const auto wasVisibleTop = _visibleTop;
+	_scrollAnchor = computeScrollState();
+	change();
+	applyScrollAnchor();
+	_scrollAnchor = ScrollState();
+	if (_visibleTop != wasVisibleTop) {
+		_scrollTopRequests.fire(_widget.y() + _visibleTop);
 	}
-	auto height = (_pendingRows.empty() && _rows.empty())
+}
+
+void History::layoutRows(int width) {
+	const auto countHeights = [&](
+			const std::vector<std::unique_ptr<HistoryRow>> &rows,
+			auto &&hidden) {
+		auto result = std::vector<int>();
+		result.reserve(rows.size());
+		for (const auto &row : rows) {
+			row->resizeToWidth(width);
+			result.push_back(hidden(int(result.size())) ? 0 : row->height());
+		}
+		return result;
+	};
+	_pendingHeights.assign(countHeights(_pendingRows, [](int) {
+		return false;
+	}));
+	_heights.assign(countHeights(_rows, [&](int i) {
+		return bool(_rowFlags[i] & RowFlag::Hidden);
+	}));
+	_widget.resize(width, countHeight());
+}
+
+int History::countHeight() const {
+	return (_pendingRows.empty() && _rows.empty())
 		? 0
-		: st::walletRowsSkip;
-	for (const auto &row : ranges::view::concat(_pendingRows, _rows)) {
-		row->setTop(height);
-		row->resizeToWidth(width);
-		height += row->height();
+		: (rowsTop() + _heights.total() + st::walletRowsSkip);
+}
+
+void History::refreshHeight() {
+	_widget.resize(_widget.width(), countHeight());
+}
+
+int History::rowsTop() const {
+	return st::walletRowsSkip + _pendingHeights.total();
+}
+
+int History::rowTop(int index) const {
+	return rowsTop() + _heights.top(index);
+}
+
+void History::refreshRowHeight(int index) {
+	Expects(index >= 0 && index < _rows.size());
+
+	const auto &row = _rows[index];
+	row->resizeToWidth(_widget.width());
+	_heights.set(
+		index,
+		(_rowFlags[index] & RowFlag::Hidden) ? 0 : row->height());
+}
+
+bool History::setRowHidden(int index, bool hidden) {
+	Expects(index >= 0 && index < _rows.size());
+
+	auto &flags = _rowFlags[index];
+	if (bool(flags & RowFlag::Hidden) == hidden) {
+		return false;
+	} else if (hidden) {
+		flags |= RowFlag::Hidden;
+	} else {
+		flags &= ~RowFlag::Hidden;
 	}
-	if (height > 0) {
-		height += st::walletRowsSkip;
+	refreshRowHeight(index);
+	return true;
+}
+
+void History::setSearchQuery(const QString &query) {
+	auto prepared = HistorySearchIndex::PrepareQuery(query);
+	if (_searchQuery == prepared) {
+		return;
+	}
+	_searchQuery = std::move(prepared);
+	applySearch();
+	checkPreload(crl::now());
+}
+
+void History::applySearch() {
+	const auto count = int(_rows.size());
+	auto shown = std::vector<bool>(count, _searchQuery.isEmpty());
+	if (!_searchQuery.isEmpty()) {
+		for (const auto &id : _searchIndex.find(_searchQuery)) {
+			const auto index = findIndex(id);
+			if (index >= 0 && index < count) {
+				shown[index] = true;
+			}
+		}
+	}
+	auto changed = false;
+	for (auto i = 0; i != count; ++i) {
+		if (setRowHidden(i, !shown[i])) {
+			changed = true;
+		}
+	}
+	if (changed) {
+		selectRow(-1, nullptr);
+		refreshShowDates();
+		_widget.update();
 	}
-	_widget.resize(width, height);
 }
 
 rpl::producer<int> History::heightValue() const {
@@ -523,22 +919,92 @@ rpl::producer<int> History::heightValue() const {
 }
 
 void History::setVisibleTopBottom(int top, int bottom) {
+	const auto now = crl::now();
+	updateScrollVelocity(top - _widget.y(), now);
 	_visibleTop = top - _widget.y();
 	_visibleBottom = bottom - _widget.y();
-	if (_visibleBottom <= _visibleTop || !_previousId.lt || _rows.empty()) {
+
+	// Rows prepared above the viewport change from estimated heights.
+	keepScrollAnchor([&] {
+		refreshPreparedRange();
+	});
+	applyResidentLimit();
+	checkPreload(now);
+}
+
+void History::checkPreload(crl::time now) {
+	// Search looks only through the loaded transactions, so a short
+	// filtered list doesn't page through the whole account history.
+	if (_visibleBottom <= _visibleTop
+		|| !_previousId.lt
+		|| _rows.empty()
+		|| !_searchQuery.isEmpty()) {
 		return;
 	}
+	if (_visibleBottom + countPreloadHeight() >= _widget.height()) {
+		requestPreload(now);
+	}
+}
+
+void History::updateScrollVelocity(int visibleTop, crl::time now) {
+	const auto elapsed = now - _scrollVelocityUpdated;
+	_scrollVelocityUpdated = now;
+	if (elapsed <= 0) {
+		return;
+	} else if (elapsed > kScrollVelocityTimeout) {
+		_scrollVelocity = 0.;
+		return;
+	}
+	const auto velocity = float64(visibleTop - _visibleTop) / elapsed;
+	_scrollVelocity = (_scrollVelocity + velocity) / 2.;
+}
+
+int History::countPreloadHeight() const {
 	const auto visibleHeight = (_visibleBottom - _visibleTop);
-	const auto preloadHeight = kPreloadScreens * visibleHeight;
-	if (_visibleBottom + preloadHeight >= _widget.height()) {
-		_preloadRequests.fire_copy(_previousId);
+	const auto latency = _preloadLatency
+		? _preloadLatency
+		: kPreloadLatencyDefault;
+
+	// Cover the distance scrolled while the slice is loading, twice.
+	const auto ahead = std::max(_scrollVelocity, 0.) * latency * 2.;
+	return std::clamp(
+		int(std::ceil(ahead)),
+		kPreloadScreensMin * visibleHeight,
+		kPreloadScreensMax * visibleHeight);
+}
+
+void History::requestPreload(crl::time now) {
+	if (_preloadRequested == _previousId
+		&& now - _preloadRequestedAt < kPreloadRetryTimeout) {
+		return;
 	}
+	_preloadRequested = _previousId;
+	_preloadRequestedAt = now;
+	_preloadRequests.fire_copy(_previousId);
+}
+
+void History::preloadDone(const Ton::TransactionId &after) {
+	if (_preloadRequested != after) {
+		return;
+	}
+	const auto latency = crl::now() - _preloadRequestedAt;
+	_preloadLatency = _preloadLatency
+		? ((_preloadLatency * 3 + latency) / 4)
+		: latency;
+	_preloadRequested = Ton::TransactionId();
+	WALLET_LOG(("History: slice loaded in %1 ms, average %2 ms."
+		).arg(latency
+		).arg(_preloadLatency));
 }
 
 rpl::producer<Ton::TransactionId> History::preloadRequests() const {
 	return _preloadRequests.events();
 }
 
+rpl::producer<int> History::scrollTopRequests() const {
+	return _scrollTopRequests.events();
+}
+
 rpl::producer<Ton::Transaction> History::viewRequests() const {
 	return _viewRequests.events();
 }
@@ -547,6 +1013,10 @@ rpl::producer<Ton::Transaction> History::decryptRequests() const {
 	return _decryptRequests.events();
 }
 
+rpl::producer<std::vector<Ton::TransactionId>> History::listResets() const {
+	return _listResets.events();
+}
+
 rpl::lifetime &History::lifetime() {
 	return _widget.lifetime();
 }
@@ -560,18 +1030,40 @@ void History::setupContent(
 		mergeState(std::move(state));
 	}, lifetime());
 
+	rpl::duplicate(
+		loaded
+	) | rpl::filter([=](const Ton::LoadedSlice &slice) {
+		return (_evictedRequested.lt != 0)
+			&& (slice.after == _evictedRequested)
+			&& (slice.after != _previousId);
+	}) | rpl::start_with_next([=](Ton::LoadedSlice &&slice) {
+		_evictedRequested = Ton::TransactionId();
+		const auto index = findIndex(slice.after);
+		if (index >= 0) {
+			keepScrollAnchor([&] {
+				restorePayloads(index, slice.data.list);
+				refreshPreparedRange();
+			});
+			_widget.update();
+		}
+	}, lifetime());
+
 	std::move(
 		loaded
 	) | rpl::filter([=](const Ton::LoadedSlice &slice) {
 		return (slice.after == _previousId);
 	}) | rpl::start_with_next([=](Ton::LoadedSlice &&slice) {
+		preloadDone(slice.after);
 		const auto loadedLast = (_previousId.lt != 0)
 			&& (slice.data.previousId.lt == 0);
+		const auto from = int(_listData.size());
 		_previousId = slice.data.previousId;
 		_listData.insert(
 			end(_listData),
 			slice.data.list.begin(),
 			slice.data.list.end());
+		_evicted.resize(_listData.size(), false);
+		indexAppended(from);
 		if (loadedLast) {
 			computeInitTransactionId();
 		}
@@ -588,9 +1080,16 @@ void History::setupContent(
 	_widget.events(
 	) | rpl::start_with_next([=](not_null<QEvent*> e) {
 		switch (e->type()) {
-		case QEvent::Leave: selectRow(-1, nullptr); return;
+		case QEvent::Leave:
+			_selectByMouseTimer.cancel();
+			selectRow(-1, nullptr);
+			return;
 		case QEvent::Enter:
-		case QEvent::MouseMove: selectRowByMouse(); return;
+			mouseMoved(_widget.mapFromGlobal(QCursor::pos()));
+			return;
+		case QEvent::MouseMove:
+			mouseMoved(static_cast<QMouseEvent*>(e.get())->pos());
+			return;
 		case QEvent::MouseButtonPress: pressRow(); return;
 		case QEvent::MouseButtonRelease: releaseRow(); return;
 		}
@@ -601,45 +1100,79 @@ void History::selectRow(int selected, ClickHandlerPtr handler) {
 	Expects(selected >= 0 || !handler);
 
 	if (_selected != selected) {
-		const auto was = (_selected >= 0 && _selected < int(_rows.size()))
-			? _rows[_selected].get()
-			: nullptr;
-		if (was) repaintRow(was);
+		if (_selected >= 0 && _selected < int(_rows.size())) {
+			_rows[_selected]->clearCache();
+			repaintRow(_selected);
+		}
 		_selected = selected;
 		_widget.setCursor((_selected >= 0)
 			? style::cur_pointer
 			: style::cur_default);
 	}
 	if (ClickHandler::getActive() != handler) {
-		const auto now = (_selected >= 0 && _selected < int(_rows.size()))
-			? _rows[_selected].get()
-			: nullptr;
-		if (now) repaintRow(now);
+		if (_selected >= 0 && _selected < int(_rows.size())) {
+			_rows[_selected]->clearCache();
+			repaintRow(_selected);
+		}
 		ClickHandler::setActive(handler);
 	}
 }
 
-void History::selectRowByMouse() {
-	const auto point = _widget.mapFromGlobal(QCursor::pos());
-	const auto from = ranges::upper_bound(
-		_rows,
-		point.y(),
-		ranges::less(),
-		&HistoryRow::bottom);
-	const auto till = ranges::lower_bound(
-		_rows,
-		point.y(),
-		ranges::less(),
-		&HistoryRow::top);
+void History::mouseMoved(QPoint position) {
+	_mousePosition = position;
+	if (_selectByMouseTimer.isActive()) {
+		return;
+	}
+	const auto wait = _lastHitTest + kHitTestInterval - crl::now();
+	if (wait > 0) {
+		_selectByMouseTimer.callOnce(wait);
+	} else {
+		selectRowByMouse();
+	}
+}
 
-	if (from != till && (*from)->isUnderCursor(point)) {
-		selectRow(from - begin(_rows), (*from)->handlerUnderCursor(point));
+void History::selectRowByMouse() {
+	countHitTest();
+	const auto point = _mousePosition;
+	const auto y = point.y() - rowsTop();
+	const auto from = _heights.findByBottom(y);
+	const auto till = _heights.findByTop(y);
+	const auto local = (from != till)
+		? (point - QPoint(0, rowTop(from)))
+		: QPoint();
+	if (from != till
+		&& (_rowFlags[from] & RowFlag::Prepared)
+		&& _rows[from]->isUnderCursor(local)) {
+		selectRow(from, _rows[from]->handlerUnderCursor(local));
 	} else {
 		selectRow(-1, nullptr);
 	}
 }
 
+void History::countHitTest() {
+	const auto now = crl::now();
+	_lastHitTest = now;
+	if (now - _hitTestsSecondStart >= 1000) {
+		_hitTestsLastSecond = (now - _hitTestsSecondStart < 2000)
+			? _hitTestsThisSecond
+			: 0;
+		_hitTestsThisSecond = 0;
+		_hitTestsSecondStart = now;
+	}
+	++_hitTestsThisSecond;
+}
+
+int History::hitTestsPerSecond() const {
+	return (crl::now() - _hitTestsSecondStart < 2000)
+		? _hitTestsLastSecond
+		: 0;
+}
+
 void History::pressRow() {
+	if (_selectByMouseTimer.isActive()) {
+		_selectByMouseTimer.cancel();
+		selectRowByMouse();
+	}
 	_pressed = _selected;
 	ClickHandler::pressed();
 }
@@ -654,157 +1187,532 @@ void History::releaseRow() {
 	}
 	if (handler) {
 		handler->onClick(ClickContext());
-	} else {
-		const auto i = ranges::find(
-			_listData,
-			_rows[_selected]->id(),
-			&Ton::Transaction::id);
-		Assert(i != end(_listData));
-		_viewRequests.fire_copy(*i);
+	} else if (!_evicted[_selected]) {
+		Assert(_rowIds[_selected] == _listData[_selected].id);
+		_viewRequests.fire_copy(_listData[_selected]);
 	}
 }
 
 void History::decryptById(const Ton::TransactionId &id) {
-	const auto i = ranges::find(_listData, id, &Ton::Transaction::id);
-	Assert(i != end(_listData));
-	_decryptRequests.fire_copy(*i);
+	const auto index = findIndex(id);
+	Assert(index >= 0);
+	_decryptRequests.fire_copy(_listData[index]);
+}
+
+void History::collectEncryptedRows(
+		not_null<CollectedEncrypted*> collected) const {
+	// Rows in the viewport go first, the rest keep the newest first order.
+	const auto top = rowsTop();
+	const auto from = _heights.findByBottom(_visibleTop - top);
+	const auto till = _heights.findByTop(_visibleBottom - top);
+	for (auto i = 0, count = int(_listData.size()); i != count; ++i) {
+		const auto &data = _listData[i];
+		if (!IsEncryptedMessage(data)) {
+			continue;
+		}
+		const auto visible = (i >= from)
+			&& (i < till)
+			&& !(_rowFlags[i] & RowFlag::Hidden);
+		(visible
+			? collected->visible
+			: collected->background).push_back(data);
+	}
 }
 
 void History::paint(Painter &p, QRect clip) {
 	if (_pendingRows.empty() && _rows.empty()) {
 		return;
 	}
+	auto rendered = false;
 	const auto paintRows = [&](
-			const std::vector<std::unique_ptr<HistoryRow>> &rows) {
-		const auto from = ranges::upper_bound(
-			rows,
-			clip.top(),
-			ranges::less(),
-			&HistoryRow::bottom);
-		const auto till = ranges::lower_bound(
-			rows,
-			clip.top() + clip.height(),
-			ranges::less(),
-			&HistoryRow::top);
+			const std::vector<std::unique_ptr<HistoryRow>> &rows,
+			const HistoryHeights &heights,
+			int rowsTop,
+			bool canStick,
+			auto &&flags,
+			auto &&previousDate,
+			auto &&dayTotal) {
+		const auto from = heights.findByBottom(clip.top() - rowsTop);
+		const auto till = heights.findByTop(
+			clip.top() + clip.height() - rowsTop);
 		if (from == till) {
 			return;
 		}
-		for (const auto &row : ranges::make_subrange(from, till)) {
-			row->paint(p, 0, row->top());
-		}
-		auto lastDateTop = rows.back()->bottom();
-		const auto dates = ranges::make_subrange(begin(rows), till);
-		for (const auto &row : dates | ranges::view::reverse) {
-			if (!row->showDate()) {
+		for (auto i = from; i != till; ++i) {
+			if (flags(i) & RowFlag::Hidden) {
 				continue;
 			}
+			const auto top = rowsTop + heights.top(i);
+			const auto &time = timeText(rows[i]->date().time());
+			if (!_rowsCacheEnabled) {
+				rows[i]->paint(p, 0, top, time);
+			} else if (rows[i]->paintCached(p, 0, top, time)) {
+				rendered = true;
+			}
+		}
+		auto lastDateTop = rowsTop + heights.total();
+		for (auto i = previousDate(till); i >= 0; i = previousDate(i)) {
+			const auto rowTop = rowsTop + heights.top(i);
 			const auto top = std::max(
 				std::min(_visibleTop, lastDateTop - st::walletRowDateHeight),
-				row->top());
-			row->paintDate(p, 0, top);
-			if (row->top() <= _visibleTop) {
+				rowTop);
+			// Only the topmost header can be pinned and have a shadow.
+			const auto sticky = canStick && (rowTop <= _visibleTop);
+			const auto shadow = sticky
+				? stickyDateShadow(top, (top != rowTop))
+				: 0.;
+			const auto total = dayTotal(i);
+			rows[i]->paintDate(
+				p,
+				0,
+				top,
+				dateText(rows[i]->date().date(), rows[i]->pending()),
+				total ? &total->text : nullptr,
+				total && (total->value > 0),
+				shadow);
+			if (rowTop <= _visibleTop) {
 				break;
 			}
 			lastDateTop = top;
 		}
 	};
-	paintRows(_pendingRows);
-	paintRows(_rows);
+	const auto top = rowsTop();
+	const auto pendingSticky = (_visibleTop < top);
+	paintRows(
+		_pendingRows,
+		_pendingHeights,
+		st::walletRowsSkip,
+		pendingSticky,
+		[](int i) { return RowFlags(); },
+		[&](int i) {
+			// There are only a few pending rows, the first one has a date.
+			while (i > 0) {
+				if (_pendingRows[--i]->showDate()) {
+					return i;
+				}
+			}
+			return -1;
+		},
+		[](int i) -> const DayTotal* { return nullptr; });
+	paintRows(
+		_rows,
+		_heights,
+		top,
+		!pendingSticky,
+		[&](int i) { return _rowFlags[i]; },
+		[&](int i) { return previousDateRow(i); },
+		[&](int i) { return dayTotal(_rows[i]->date().date()); });
+	if (rendered) {
+		applyRowsCacheLimit();
+	}
+}
+
+auto History::dayTotal(const QDate &date) -> const DayTotal* {
+	// Laid out only when a date header is painted, the value is kept
+	// to notice when the text is outdated.
+	const auto value = _totals.dayTotal(date);
+	if (!value) {
+		return nullptr;
+	}
+	auto &result = _dayTotals[date.toJulianDay()];
+	if (result.value != value) {
+		result.value = value;
+		result.text.setText(
+			st::defaultTextStyle,
+			FormatAmount(value, FormatFlag::Signed | FormatFlag::Rounded).full);
+	}
+	return &result;
+}
+
+const Ui::Text::String &History::timeText(const QTime &time) {
+	const auto minute = time.hour() * 60 + time.minute();
+	const auto [i, inserted] = _timeTexts.try_emplace(minute);
+	if (inserted) {
+		i->second.setText(
+			st::defaultTextStyle,
+			ph::lng_wallet_short_time(time)(ph::now));
+	}
+	return i->second;
+}
+
+const Ui::Text::String &History::dateText(const QDate &date, bool pending) {
+	if (pending) {
+		if (_pendingDateText.isEmpty()) {
+			_pendingDateText.setText(
+				st::semiboldTextStyle,
+				ph::lng_wallet_row_pending_date(ph::now));
+		}
+		return _pendingDateText;
+	}
+	const auto [i, inserted] = _dateTexts.try_emplace(date.toJulianDay());
+	if (inserted) {
+		i->second.setText(
+			st::semiboldTextStyle,
+			ph::lng_wallet_short_date(date)(ph::now));
+	}
+	return i->second;
+}
+
+void History::clearTexts() {
+	_timeTexts.clear();
+	_dateTexts.clear();
+	_pendingDateText = Ui::Text::String();
+}
+
+void History::refreshTexts() {
+	clearTexts();
+	for (auto i = _preparedFrom; i != _preparedTill; ++i) {
+		if (_rowFlags[i] & RowFlag::Prepared) {
+			prepareRow(i);
+			refreshRowHeight(i);
+		}
+	}
+	for (auto i = 0, count = int(_pendingRows.size()); i != count; ++i) {
+		_pendingRows[i]->prepare(_pendingData[i].fake);
+	}
+	refreshPending();
+	_widget.update();
+}
+
+int History::previousDateRow(int index) const {
+	const auto i = _dateRows.lower_bound(_firstPosition + index);
+	return (i != begin(_dateRows)) ? (*std::prev(i) - _firstPosition) : -1;
+}
+
+void History::refreshPreparedRange() {
+	applyScrollAnchor();
+	const auto visibleHeight = (_visibleBottom - _visibleTop);
+	if (visibleHeight <= 0 || !_widget.width()) {
+		return;
+	}
+	const auto bandHeight = (_preparedBandHeight >= 0)
+		? std::min(_preparedBandHeight, kLayoutBandScreens * visibleHeight)
+		: (kLayoutBandScreens * visibleHeight);
+	const auto top = rowsTop();
+	const auto from = _heights.findByBottom(_visibleTop - bandHeight - top);
+	const auto till = _heights.findByTop(_visibleBottom + bandHeight - top);
+	for (auto i = _preparedFrom; i != _preparedTill; ++i) {
+		if (i < from || i >= till) {
+			unprepareRow(i);
+		}
+	}
+	auto changed = false;
+	auto firstEvicted = -1;
+	for (auto i = from; i != till; ++i) {
+		if (_rowFlags[i] & RowFlag::Hidden) {
+			continue;
+		} else if (_evicted[i]) {
+			if (firstEvicted < 0) {
+				firstEvicted = i;
+			}
+		} else if (!(_rowFlags[i] & RowFlag::Prepared)) {
+			prepareRow(i);
+			refreshRowHeight(i);
+			changed = true;
+		}
+	}
+	_preparedFrom = from;
+	_preparedTill = till;
+	if (refreshStaleDates(from, till)) {
+		changed = true;
+	}
+	if (changed) {
+		refreshHeight();
+	}
+	if (firstEvicted >= 0) {
+		requestEvicted(firstEvicted);
+	}
+}
+
+void History::applyResidentLimit() {
+	const auto resident = int(_listData.size()) - _evictedCount;
+	if (resident <= kResidentRowsMax || resident == _residentNotEvictable) {
+		return;
+	}
+	// Evict from both ends, leaving the rows around the viewport.
+	auto above = 0;
+	auto below = int(_listData.size());
+	const auto keep = [&](int index) {
+		return _evicted[index]
+			|| (index >= _preparedFrom && index < _preparedTill)
+			|| IsDecryptedMessage(_listData[index]);
+	};
+	while (int(_listData.size()) - _evictedCount > kResidentRowsAfterEviction
+		&& (above < _preparedFrom || below > _preparedTill)) {
+		const auto index = ((_preparedFrom - above) >= (below - _preparedTill))
+			? above++
+			: --below;
+		if (!keep(index)) {
+			evictPayload(index);
+		}
+	}
+	// Don't scan again on each scroll while the resident set is the same.
+	const auto left = int(_listData.size()) - _evictedCount;
+	_residentNotEvictable = (left > kResidentRowsMax) ? left : -1;
+}
+
+void History::evictPayload(int index) {
+	Expects(index >= 0 && index < _listData.size());
+	Expects(!_evicted[index]);
+
+	auto &data = _listData[index];
+	auto stub = Ton::Transaction();
+	stub.id = data.id;
+	stub.time = data.time;
+	data = std::move(stub);
+	_evicted[index] = true;
+	++_evictedCount;
+}
+
+void History::restorePayloads(
+		int index,
+		const std::vector<Ton::Transaction> &list,
+		int from) {
+	const auto count = int(_listData.size());
+	for (const auto &data : list | ranges::view::drop(from)) {
+		if (index == count || _listData[index].id != data.id) {
+			break;
+		} else if (_evicted[index]) {
+			_listData[index] = data;
+			_listData[index].initializing = (_initTransactionId == data.id);
+			_evicted[index] = false;
+			--_evictedCount;
+		}
+		++index;
+	}
+}
+
+void History::requestEvicted(int index) {
+	Expects(index >= 0 && index < _listData.size());
+
+	const auto &id = _listData[index].id;
+	const auto now = crl::now();
+	if (_evictedRequested == id
+		&& now - _evictedRequestedAt < kPreloadRetryTimeout) {
+		return;
+	}
+	// The slice starts with this transaction and goes down the list.
+	_evictedRequested = id;
+	_evictedRequestedAt = now;
+	_preloadRequests.fire_copy(id);
 }
 
 History::ScrollState History::computeScrollState() const {
-	const auto item = ranges::upper_bound(
-		_rows,
-		_visibleTop,
-		ranges::less(),
-		&HistoryRow::bottom);
-	if (item == _rows.end()
-		|| (item == _rows.begin()
-			&& _rows.front()->id() == _listData.front().id)) {
+	const auto index = _heights.findByBottom(_visibleTop - rowsTop());
+	if (index == _rows.size()
+		|| (!index && _rowIds.front() == _listData.front().id)) {
 		return ScrollState();
 	}
 	auto result = ScrollState();
-	result.top = (*item)->id();
-	result.offset = _visibleTop - (*item)->top();
+	result.top = _rowIds[index];
+	result.offset = _visibleTop - rowTop(index);
 	return result;
 }
 
-void History::mergeState(HistoryState &&state) {
-	if (mergePendingChanged(std::move(state.pendingTransactions))) {
-		refreshPending();
+void History::applyScrollAnchor() {
+	if (!_scrollAnchor.top.lt) {
+		return;
 	}
-	if (mergeListChanged(std::move(state.lastTransactions))) {
-		refreshRows();
+	const auto index = findIndex(_scrollAnchor.top);
+	if (index < 0 || index >= _rows.size()) {
+		return;
 	}
+	// Only the height inserted above the anchor moves the visible area.
+	const auto delta = rowTop(index) + _scrollAnchor.offset - _visibleTop;
+	_visibleTop += delta;
+	_visibleBottom += delta;
+}
+
+void History::mergeState(HistoryState &&state) {
+	keepScrollAnchor([&] {
+		if (mergePendingChanged(std::move(state.pendingTransactions))) {
+			refreshPending();
+		}
+		if (mergeListChanged(std::move(state.lastTransactions))) {
+			refreshRows();
+		}
+		applyBalance(state.balance);
+	});
 }
 
 bool History::mergePendingChanged(
 		std::vector<Ton::PendingTransaction> &&list) {
-	if (_pendingData == list) {
-		return false;
+	// Rows are matched by the sent transaction, so the sends that are
+	// still pending keep their rows and layouts. Usually a send is found
+	// at the same position, or shifted by the sends added in front.
+	const auto count = int(_pendingData.size());
+	const auto added = std::max(int(list.size()) - count, 0);
+	const auto findRow = [&](const Ton::Transaction &fake, int index) {
+		const auto matches = [&](int i) {
+			return (i >= 0)
+				&& (i < count)
+				&& (_pendingRows[i] != nullptr)
+				&& (_pendingData[i].fake == fake);
+		};
+		if (matches(index)) {
+			return index;
+		} else if (matches(index - added)) {
+			return index - added;
+		}
+		for (auto i = 0; i != count; ++i) {
+			if (matches(i)) {
+				return i;
+			}
+		}
+		return -1;
+	};
+	auto changed = (int(list.size()) != count);
+	auto rows = std::vector<std::unique_ptr<HistoryRow>>();
+	rows.reserve(list.size());
+	for (const auto &data : list) {
+		const auto index = int(rows.size());
+		const auto found = findRow(data.fake, index);
+		if (found >= 0) {
+			rows.push_back(std::move(_pendingRows[found]));
+			if (found != index) {
+				changed = true;
+			}
+		} else {
+			rows.push_back(makeRow(data.fake));
+			rows.back()->prepare(data.fake);
+			changed = true;
+		}
 	}
 	_pendingData = std::move(list);
-	return true;
+	_pendingRows = std::move(rows);
+	return changed;
 }
 
 bool History::mergeListChanged(Ton::TransactionsSlice &&data) {
+	// Transaction id contains the hash of the transaction contents,
+	// so an unchanged emission is detected by comparing the first ids.
+	const auto unchanged = !_listData.empty()
+		&& !data.list.empty()
+		&& (data.list.front().id == _listData.front().id);
+	if (unchanged) {
+		if (_evicted.front()) {
+			restorePayloads(0, data.list);
+		}
+		return false;
+	}
 	const auto i = _listData.empty()
 		? data.list.cend()
-		: ranges::find(std::as_const(data.list), _listData.front());
+		: ranges::find(
+			std::as_const(data.list),
+			_listData.front().id,
+			&Ton::Transaction::id);
 	if (i == data.list.cend()) {
 		_listData = data.list | ranges::to_vector;
+		_evicted.assign(_listData.size(), false);
+		_evictedCount = 0;
 		_previousId = std::move(data.previousId);
+		indexReset();
 		if (!_previousId.lt) {
 			computeInitTransactionId();
 		}
+		auto encrypted = _listData | ranges::view::filter(
+			IsEncryptedMessage
+		) | ranges::view::transform(
+			&Ton::Transaction::id
+		) | ranges::to_vector;
+		if (!encrypted.empty()) {
+			_listResets.fire(std::move(encrypted));
+		}
 		return true;
-	} else if (i != data.list.cbegin()) {
+	}
+	const auto added = int(i - data.list.cbegin());
+	if (_evictedCount > 0) {
+		restorePayloads(0, data.list, added);
+	}
+	if (added > 0) {
 		_listData.insert(begin(_listData), data.list.cbegin(), i);
+		_evicted.insert(begin(_evicted), added, false);
+		indexPrepended(added);
 		return true;
 	}
 	return false;
 }
 
-void History::setRowShowDate(
-		const std::unique_ptr<HistoryRow> &row,
-		bool show) {
-	const auto raw = row.get();
-	row->setShowDate(show, [=] { repaintShadow(raw); });
-}
-
-bool History::takeDecrypted(
-		int index,
-		const std::vector<Ton::Transaction> &decrypted) {
-	Expects(index >= 0 && index < _listData.size());
-	Expects(index >= 0 && index < _rows.size());
-	Expects(_rows[index]->id() == _listData[index].id);
-
-	const auto i = ranges::find(
-		decrypted,
-		_listData[index].id,
-		&Ton::Transaction::id);
-	if (i == end(decrypted)) {
+bool History::takeDecrypted(const Ton::Transaction &decrypted) {
+	const auto index = findIndex(decrypted.id);
+	if (index < 0
+		|| index >= _rows.size()
+		|| (!_evicted[index] && !IsEncryptedMessage(_listData[index]))) {
 		return false;
 	}
-	if (IsEncryptedMessage(*i)) {
+	Assert(_rowIds[index] == decrypted.id);
+
+	if (IsEncryptedMessage(decrypted)) {
 		_rows[index]->setDecryptionFailed();
+		refreshRowHeight(index);
 	} else {
-		_listData[index] = *i;
-		_rows[index] = makeRow(*i);
+		// The decrypted copy restores the payload of an evicted row.
+		if (_evicted[index]) {
+			_evicted[index] = false;
+			--_evictedCount;
+		}
+		_listData[index] = decrypted;
+		_listData[index].initializing = (_initTransactionId == decrypted.id);
+		replaceRow(index, _listData[index]);
+		_searchIndex.add(decrypted);
+		if (!_searchQuery.isEmpty()) {
+			const auto hidden = !_searchIndex.matches(
+				decrypted.id,
+				_searchQuery);
+			if (setRowHidden(index, hidden)) {
+				updateShowDates(index, index + 1);
+			}
+		}
 	}
 	return true;
 }
 
+void History::replaceRow(int index, const Ton::Transaction &data) {
+	Expects(index >= 0 && index < _rows.size());
+
+	const auto showDate = _rows[index]->showDate();
+	_rows[index] = makeRow(data);
+	if (showDate) {
+		_rows[index]->setShowDate(true);
+	}
+	if (_rowFlags[index] & RowFlag::Prepared) {
+		_rows[index]->prepare(data, balanceAfter(index));
+	}
+	refreshRowHeight(index);
+}
+
+void History::prepareRow(int index) {
+	Expects(index >= 0 && index < _rows.size());
+
+	_rows[index]->prepare(_listData[index], balanceAfter(index));
+	_rowFlags[index] |= RowFlag::Prepared;
+}
+
+std::optional<int64> History::balanceAfter(int index) const {
+	return (_showBalances && index < _totals.size())
+		? _totals.balanceAfter(index)
+		: std::nullopt;
+}
+
+void History::unprepareRow(int index) {
+	Expects(index >= 0 && index < _rows.size());
+
+	_rows[index]->unprepare();
+	_rowFlags[index] &= ~RowFlag::Prepared;
+}
+
 std::unique_ptr<HistoryRow> History::makeRow(const Ton::Transaction &data) {
 	const auto id = data.id;
 	if (const auto pending = (id.lt == 0)) {
 		return std::make_unique<HistoryRow>(data);
 	}
 	const auto isInitTransaction = (_initTransactionId == id);
-	return std::make_unique<HistoryRow>(
+	auto result = std::make_unique<HistoryRow>(
 		data,
 		[=] { decryptById(id); },
 		isInitTransaction);
+	result->setShowBalance(_showBalances);
+	return result;
 }
 
 void History::computeInitTransactionId() {
@@ -824,63 +1732,165 @@ void History::computeInitTransactionId() {
 	}
 
 	_initTransactionId = now;
-	const auto wasItem = ranges::find(_listData, was, &Ton::Transaction::id);
-	if (wasItem != end(_listData)) {
-		wasItem->initializing = false;
-		const auto wasRow = ranges::find(_rows, was, &HistoryRow::id);
-		if (wasRow != end(_rows)) {
-			*wasRow = makeRow(*wasItem);
+	const auto hasRow = [&](int index, const Ton::TransactionId &id) {
+		return (index < _rowIds.size()) && (_rowIds[index] == id);
+	};
+	const auto wasIndex = findIndex(was);
+	if (wasIndex >= 0) {
+		auto &wasItem = _listData[wasIndex];
+		wasItem.initializing = false;
+		if (hasRow(wasIndex, was)) {
+			replaceRow(wasIndex, wasItem);
 		}
 	}
 	if (found) {
 		found->initializing = true;
-		const auto nowRow = ranges::find(_rows, now, &HistoryRow::id);
-		if (nowRow != end(_rows)) {
-			*nowRow = makeRow(*found);
+		const auto nowIndex = int(found - _listData.data());
+		if (hasRow(nowIndex, now)) {
+			replaceRow(nowIndex, *found);
 		}
 	}
 }
 
+int History::findIndex(const Ton::TransactionId &id) const {
+	const auto i = _positionById.find(id);
+	return (i != end(_positionById)) ? (i->second - _firstPosition) : -1;
+}
+
+void History::indexPrepended(int count) {
+	Expects(count >= 0 && count <= _listData.size());
+
+	_firstPosition -= count;
+	for (auto i = 0; i != count; ++i) {
+		_positionById[_listData[i].id] = _firstPosition + i;
+		_searchIndex.add(_listData[i]);
+	}
+	for (auto i = count; i != 0;) {
+		const auto &data = _listData[--i];
+		_totals.pushFront(data, base::unixtime::parse(data.time).date());
+	}
+}
+
+void History::indexAppended(int from) {
+	Expects(from >= 0 && from <= _listData.size());
+
+	for (auto i = from, count = int(_listData.size()); i != count; ++i) {
+		const auto &data = _listData[i];
+		_positionById[data.id] = _firstPosition + i;
+		_searchIndex.add(data);
+		_totals.pushBack(data, base::unixtime::parse(data.time).date());
+	}
+}
+
+void History::indexReset() {
+	_positionById.clear();
+	_searchIndex.clear();
+	_totals.clear();
+	_dayTotals.clear();
+	clearTexts();
+	_dateRows.clear();
+	_firstPosition = 0;
+	indexAppended(0);
+}
+
 void History::refreshShowDates() {
+	refreshShowDates(0, int(_rows.size()));
+}
+
+bool History::refreshStaleDates(int from, int till) {
+	auto changedFrom = till;
+	auto changedTill = from;
+	for (auto i = from; i != till; ++i) {
+		const auto &row = _rows[i];
+		if (row->dateStale() && row->refreshDate()) {
+			_totals.setDate(i, row->date().date());
+			changedFrom = std::min(changedFrom, i);
+			changedTill = i + 1;
+		}
+	}
+	if (changedFrom >= changedTill) {
+		return false;
+	}
+	updateShowDates(changedFrom, changedTill);
+	return true;
+}
+
+void History::refreshShowDates(int from, int till) {
+	updateShowDates(from, till);
+	refreshPreparedRange();
+	refreshHeight();
+}
+
+void History::updateShowDates(int from, int till) {
+	const auto count = int(_rows.size());
+	Expects(from >= 0 && from <= till && till <= count);
+
+	// Hidden rows are skipped when comparing days, and the first shown
+	// row after the range could have lost its previous day.
 	auto previous = QDate();
-	for (const auto &row : _rows) {
+	for (auto i = from; i != 0;) {
+		if (!(_rowFlags[--i] & RowFlag::Hidden)) {
+			previous = _rows[i]->date().date();
+			break;
+		}
+	}
+	for (auto i = from; i != count; ++i) {
+		const auto &row = _rows[i];
+		auto &flags = _rowFlags[i];
+		const auto hidden = bool(flags & RowFlag::Hidden);
 		const auto current = row->date().date();
-		setRowShowDate(row, current != previous);
-		previous = current;
+		const auto show = !hidden && (current != previous);
+		if (bool(flags & RowFlag::ShowDate) != show) {
+			row->setShowDate(show);
+			if (show) {
+				flags |= RowFlag::ShowDate;
+				_dateRows.emplace(_firstPosition + i);
+			} else {
+				flags &= ~RowFlag::ShowDate;
+				_dateRows.erase(_firstPosition + i);
+			}
+			refreshRowHeight(i);
+		}
+		if (!hidden) {
+			previous = current;
+			if (i >= till) {
+				break;
+			}
+		}
 	}
-	resizeToWidth(_widget.width());
 }
 
 void History::refreshPending() {
-	_pendingRows = ranges::view::all(
-		_pendingData
-	) | ranges::view::transform([&](const Ton::PendingTransaction &data) {
-		return makeRow(data.fake);
-	}) | ranges::to_vector;
-
-	if (!_pendingRows.empty()) {
-		setRowShowDate(_pendingRows.front());
+	auto heights = std::vector<int>();
+	heights.reserve(_pendingRows.size());
+	for (const auto &row : _pendingRows) {
+		const auto showDate = heights.empty();
+		if (row->showDate() != showDate) {
+			row->setShowDate(showDate);
+		}
+		// Kept rows return right away, their width didn't change.
+		row->resizeToWidth(_widget.width());
+		heights.push_back(row->height());
 	}
-	resizeToWidth(_widget.width());
+	_pendingHeights.assign(std::move(heights));
+	refreshPreparedRange();
+	refreshHeight();
 }
 
 void History::refreshRows() {
 	auto addedFront = std::vector<std::unique_ptr<HistoryRow>>();
 	auto addedBack = std::vector<std::unique_ptr<HistoryRow>>();
 	for (const auto &element : _listData) {
-		if (!_rows.empty() && element.id == _rows.front()->id()) {
+		if (!_rowIds.empty() && element.id == _rowIds.front()) {
 			break;
 		}
 		addedFront.push_back(makeRow(element));
 	}
 	if (!_rows.empty()) {
-		const auto from = ranges::find(
-			_listData,
-			_rows.back()->id(),
-			&Ton::Transaction::id);
-		if (from != end(_listData)) {
+		const auto from = findIndex(_rowIds.back());
+		if (from >= 0) {
 			addedBack = ranges::make_subrange(
-				from + 1,
+				begin(_listData) + from + 1,
 				end(_listData)
 			) | ranges::view::transform([=](const Ton::Transaction &data) {
 				return makeRow(data);
@@ -889,30 +1899,100 @@ void History::refreshRows() {
 	}
 	if (addedFront.empty() && addedBack.empty()) {
 		return;
-	} else if (!addedFront.empty()) {
-		if (addedFront.size() < _listData.size()) {
+	}
+	const auto width = _widget.width();
+	const auto addedFrontCount = int(addedFront.size());
+	const auto addedBackFrom = int(_rows.size() + addedFront.size());
+	const auto reset = (addedFront.size() == _listData.size());
+	const auto initialFlags = [&](const std::unique_ptr<HistoryRow> &row) {
+		const auto hidden = !_searchQuery.isEmpty()
+			&& !_searchIndex.matches(row->id(), _searchQuery);
+		return hidden ? RowFlags(RowFlag::Hidden) : RowFlags();
+	};
+	const auto pushBack = [&](const std::unique_ptr<HistoryRow> &row) {
+		const auto flags = initialFlags(row);
+		row->resizeToWidth(width);
+		_heights.pushBack((flags & RowFlag::Hidden) ? 0 : row->height());
+		_rowIds.push_back(row->id());
+		_rowFlags.push_back(flags);
+	};
+	if (!addedFront.empty()) {
+		if (!reset) {
+			_preparedFrom += addedFrontCount;
+			_preparedTill += addedFrontCount;
+			auto ids = std::vector<Ton::TransactionId>();
+			auto flags = std::vector<RowFlags>();
+			ids.reserve(addedFrontCount);
+			flags.reserve(addedFrontCount);
+			for (const auto &row : addedFront) {
+				ids.push_back(row->id());
+				flags.push_back(initialFlags(row));
+			}
+			for (auto i = addedFrontCount; i != 0;) {
+				const auto &row = addedFront[--i];
+				row->resizeToWidth(width);
+				_heights.pushFront(
+					(flags[i] & RowFlag::Hidden) ? 0 : row->height());
+			}
 			addedFront.insert(
 				end(addedFront),
 				std::make_move_iterator(begin(_rows)),
 				std::make_move_iterator(end(_rows)));
+			_rowIds.insert(begin(_rowIds), begin(ids), end(ids));
+			_rowFlags.insert(begin(_rowFlags), begin(flags), end(flags));
+		} else {
+			_preparedFrom = _preparedTill = 0;
+			_rowIds.clear();
+			_rowFlags.clear();
+			_dateRows.clear();
+			_heights.clear();
+			for (const auto &row : addedFront) {
+				pushBack(row);
+			}
 		}
 		_rows = std::move(addedFront);
 	}
+	for (const auto &row : addedBack) {
+		pushBack(row);
+	}
 	_rows.insert(
 		end(_rows),
 		std::make_move_iterator(begin(addedBack)),
 		std::make_move_iterator(end(addedBack)));
 
-	refreshShowDates();
+	if (reset) {
+		refreshShowDates();
+		return;
+	}
+	if (addedFrontCount > 0) {
+		refreshShowDates(0, addedFrontCount);
+	}
+	if (!addedBack.empty()) {
+		refreshShowDates(addedBackFrom, int(_rows.size()));
+	}
+}
+
+void History::repaintRow(int index) {
+	_widget.update(0, rowTop(index), _widget.width(), _heights.height(index));
 }
 
-void History::repaintRow(not_null<HistoryRow*> row) {
-	_widget.update(0, row->top(), _widget.width(), row->height());
+float64 History::stickyDateShadow(int top, bool shown) {
+	_stickyDateTop = top;
+	if (_stickyDateShadow != shown) {
+		_stickyDateShadow = shown;
+		_stickyDateShadowShown.start(
+			[=] { repaintStickyDate(); },
+			shown ? 0. : 1.,
+			shown ? 1. : 0.,
+			st::widgetFadeDuration);
+	}
+	return _stickyDateShadowShown.value(shown ? 1. : 0.);
 }
 
-void History::repaintShadow(not_null<HistoryRow*> row) {
-	const auto min = std::min(row->top(), _visibleTop);
-	const auto delta = std::max(row->top(), _visibleTop) - min;
+void History::repaintStickyDate() {
+	const auto top = _stickyDateTop;
+	const auto min = std::min(top, _visibleTop);
+	const auto delta = std::max(top, _visibleTop) - min;
 	_widget.update(0, min, _widget.width(), delta + st::walletRowDateHeight);
 }
 
@@ -923,7 +2003,8 @@ rpl::producer<HistoryState> MakeHistoryState(
 	) | rpl::map([](Ton::WalletViewerState &&state) {
 		return HistoryState{
 			std::move(state.wallet.lastTransactions),
-			std::move(state.wallet.pendingTransactions)
+			std::move(state.wallet.pendingTransactions),
+			state.wallet.account.fullBalance
 		};
 	});
 }
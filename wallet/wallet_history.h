@@ -9,6 +9,18 @@
 #include "ui/rp_widget.h"
 #include "ton/ton_state.h"
 #include "ui/click_handler.h"
+#include "base/flags.h"
+#include "base/timer.h"
+#include "ui/effects/animations.h"
+#include "ui/text/text.h"
+#include "wallet/wallet_common.h"
+#include "wallet/wallet_decrypt_queue.h"
+#include "wallet/wallet_history_heights.h"
+#include "wallet/wallet_history_search.h"
+#include "wallet/wallet_history_totals.h"
+
+#include <set>
+#include <unordered_map>
 
 class Painter;
 
@@ -17,6 +29,7 @@ namespace Wallet {
 struct HistoryState {
 	Ton::TransactionsSlice lastTransactions;
 	std::vector<Ton::PendingTransaction> pendingTransactions;
+	int64 balance = -1;
 };
 
 class HistoryRow;
@@ -27,8 +40,7 @@ public:
 		not_null<Ui::RpWidget*> parent,
 		rpl::producer<HistoryState> state,
 		rpl::producer<Ton::LoadedSlice> loaded,
-		rpl::producer<
-			not_null<std::vector<Ton::Transaction>*>> collectEncrypted,
+		rpl::producer<not_null<CollectedEncrypted*>> collectEncrypted,
 		rpl::producer<
 			not_null<const std::vector<Ton::Transaction>*>> updateDecrypted);
 	~History();
@@ -37,10 +49,29 @@ public:
 	[[nodiscard]] rpl::producer<int> heightValue() const;
 	void setVisibleTopBottom(int top, int bottom);
 
+	// Keep rendered images of the prepared rows, so that scrolling
+	// only blits them until the row content or the palette changes.
+	void setRowsCacheEnabled(bool enabled);
+
+	// Shows only the transactions matching the query, if it isn't empty.
+	void setSearchQuery(const QString &query);
+
+	// Shows the account balance after each transaction below its fees.
+	void setShowBalances(bool show);
+
+	// Row hit-tests done during the last complete second, for profiling.
+	[[nodiscard]] int hitTestsPerSecond() const;
+
 	[[nodiscard]] rpl::producer<Ton::TransactionId> preloadRequests() const;
+	[[nodiscard]] rpl::producer<int> scrollTopRequests() const;
 	[[nodiscard]] rpl::producer<Ton::Transaction> viewRequests() const;
 	[[nodiscard]] rpl::producer<Ton::Transaction> decryptRequests() const;
 
+	// Encrypted transactions of a list that replaced the loaded one,
+	// their comments may have been decrypted in the replaced copies.
+	[[nodiscard]] rpl::producer<
+		std::vector<Ton::TransactionId>> listResets() const;
+
 	[[nodiscard]] rpl::lifetime &lifetime();
 
 private:
@@ -48,35 +79,91 @@ private:
 		Ton::TransactionId top;
 		int offset = 0;
 	};
+	enum class RowFlag : uchar {
+		Prepared = (1 << 0),
+		ShowDate = (1 << 1),
+		Hidden = (1 << 2),
+	};
+	friend inline constexpr bool is_flag_type(RowFlag) { return true; };
+	using RowFlags = base::flags<RowFlag>;
+	struct DayTotal {
+		int64 value = 0;
+		Ui::Text::String text;
+	};
 
 	void setupContent(
 		rpl::producer<HistoryState> &&state,
 		rpl::producer<Ton::LoadedSlice> &&loaded);
 	void resizeToWidth(int width);
+	void relayoutStep();
+	void keepScrollAnchor(FnMut<void()> change);
+	void layoutRows(int width);
+	void refreshPreparedRange();
+	void applyBalance(int64 balance);
+	[[nodiscard]] std::optional<int64> balanceAfter(int index) const;
+	void clearRowsCache();
+	void applyRowsCacheLimit();
+	void refreshRowHeight(int index);
+	bool setRowHidden(int index, bool hidden);
+	void applySearch();
+	void prepareRow(int index);
+	void unprepareRow(int index);
+	void refreshHeight();
+	void updateScrollVelocity(int visibleTop, crl::time now);
+	[[nodiscard]] int countPreloadHeight() const;
+	void checkPreload(crl::time now);
+	void requestPreload(crl::time now);
+	void preloadDone(const Ton::TransactionId &after);
+	[[nodiscard]] int countHeight() const;
+	[[nodiscard]] int rowsTop() const;
+	[[nodiscard]] int rowTop(int index) const;
 	void mergeState(HistoryState &&state);
 	bool mergePendingChanged(std::vector<Ton::PendingTransaction> &&list);
 	bool mergeListChanged(Ton::TransactionsSlice &&data);
 	void refreshRows();
 	void refreshPending();
 	void paint(Painter &p, QRect clip);
-	void repaintRow(not_null<HistoryRow*> row);
-	void repaintShadow(not_null<HistoryRow*> row);
+	[[nodiscard]] int previousDateRow(int index) const;
+	[[nodiscard]] const DayTotal *dayTotal(const QDate &date);
+	[[nodiscard]] const Ui::Text::String &timeText(const QTime &time);
+	[[nodiscard]] const Ui::Text::String &dateText(
+		const QDate &date,
+		bool pending);
+	void clearTexts();
+	void refreshTexts();
+	void repaintRow(int index);
+	[[nodiscard]] float64 stickyDateShadow(int top, bool shown);
+	void repaintStickyDate();
 	[[nodiscard]] ScrollState computeScrollState() const;
+	void applyScrollAnchor();
 
 	void selectRow(int selected, ClickHandlerPtr handler);
+	void mouseMoved(QPoint position);
 	void selectRowByMouse();
+	void countHitTest();
 	void pressRow();
 	void releaseRow();
 	void decryptById(const Ton::TransactionId &id);
+	void collectEncryptedRows(not_null<CollectedEncrypted*> collected) const;
 
 	void computeInitTransactionId();
+	[[nodiscard]] int findIndex(const Ton::TransactionId &id) const;
+	void indexPrepended(int count);
+	void indexAppended(int from);
+	void indexReset();
 	void refreshShowDates();
-	void setRowShowDate(
-		const std::unique_ptr<HistoryRow> &row,
-		bool show = true);
-	bool takeDecrypted(
+	void refreshShowDates(int from, int till);
+	void updateShowDates(int from, int till);
+	bool refreshStaleDates(int from, int till);
+	void applyResidentLimit();
+	void evictPayload(int index);
+	void restorePayloads(
 		int index,
-		const std::vector<Ton::Transaction> &decrypted);
+		const std::vector<Ton::Transaction> &list,
+		int from = 0);
+	void requestEvicted(int index);
+	bool takeDecrypted(const Ton::Transaction &decrypted);
+	void replaceRow(int index, const Ton::Transaction &data);
 	[[nodiscard]] std::unique_ptr<HistoryRow> makeRow(
 		const Ton::Transaction &data);
 
@@ -84,19 +171,96 @@ private:
 
 	std::vector<Ton::PendingTransaction> _pendingData;
 	std::vector<Ton::Transaction> _listData;
+
+	// Payloads of the rows far from the viewport are replaced by stubs
+	// with only the id and time left, they are loaded again on demand.
+	std::vector<bool> _evicted;
+	int _evictedCount = 0;
+	Ton::TransactionId _evictedRequested;
+	crl::time _evictedRequestedAt = 0;
+
+	// Resident rows count when nothing more could be evicted, or -1.
+	int _residentNotEvictable = -1;
+
 	Ton::TransactionId _previousId;
 	Ton::TransactionId _initTransactionId;
 
+	// Positions are shifted by _firstPosition, so that adding rows
+	// to the front doesn't require updating every stored value.
+	std::unordered_map<
+		Ton::TransactionId,
+		int,
+		TransactionIdHash> _positionById;
+	int _firstPosition = 0;
+
 	std::vector<std::unique_ptr<HistoryRow>> _pendingRows;
 	std::vector<std::unique_ptr<HistoryRow>> _rows;
+
+	// Hit-testing and clipping read only these arrays and _heights,
+	// parallel to _rows, without touching the rows themselves.
+	std::vector<Ton::TransactionId> _rowIds;
+	std::vector<RowFlags> _rowFlags;
+
+	// Rows with RowFlag::ShowDate, by position, for the sticky header.
+	std::set<int> _dateRows;
+
+	HistorySearchIndex _searchIndex;
+	HistoryTotals _totals;
+
+	// Day totals laid out for the painted date headers, by julian day.
+	std::unordered_map<qint64, DayTotal> _dayTotals;
+
+	// Time and date labels shared by the rows, by minute and julian day.
+	// Dropped with the rows index and laid out again on language change.
+	std::unordered_map<int, Ui::Text::String> _timeTexts;
+	std::unordered_map<qint64, Ui::Text::String> _dateTexts;
+	Ui::Text::String _pendingDateText;
+	QString _searchQuery;
+	HistoryHeights _pendingHeights;
+	HistoryHeights _heights;
 	int _visibleTop = 0;
 	int _visibleBottom = 0;
+
+	// The shadow under the pinned date header, shared by all the rows.
+	Ui::Animations::Simple _stickyDateShadowShown;
+	int _stickyDateTop = 0;
+	bool _stickyDateShadow = false;
+
+	// The row that should stay in place while the rows above it change.
+	ScrollState _scrollAnchor;
+
+	// Pixels per millisecond, positive when scrolling down.
+	float64 _scrollVelocity = 0.;
+	crl::time _scrollVelocityUpdated = 0;
+	Ton::TransactionId _preloadRequested;
+	crl::time _preloadRequestedAt = 0;
+
+	// Average time it takes to load an older slice, zero if unknown.
+	crl::time _preloadLatency = 0;
+
+	// Prepared band height while it grows back after a resize, or -1.
+	int _preparedBandHeight = -1;
+	base::Timer _relayoutTimer;
+	int _preparedFrom = 0;
+	int _preparedTill = 0;
+	bool _rowsCacheEnabled = false;
+	bool _showBalances = false;
 	int _selected = -1;
 	int _pressed = -1;
 
+	// Mouse moves are hit-tested at most once a frame.
+	QPoint _mousePosition;
+	base::Timer _selectByMouseTimer;
+	crl::time _lastHitTest = 0;
+	crl::time _hitTestsSecondStart = 0;
+	int _hitTestsThisSecond = 0;
+	int _hitTestsLastSecond = 0;
+
 	rpl::event_stream<Ton::TransactionId> _preloadRequests;
+	rpl::event_stream<int> _scrollTopRequests;
 	rpl::event_stream<Ton::Transaction> _viewRequests;
 	rpl::event_stream<Ton::Transaction> _decryptRequests;
+	rpl::event_stream<std::vector<Ton::TransactionId>> _listResets;
 
 };
 
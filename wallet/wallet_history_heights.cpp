@@ -0,0 +1,153 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "wallet/wallet_history_heights.h"
+
+namespace Wallet {
+namespace {
+
+constexpr auto kMinRoom = 16;
+
+} // namespace
+
+int HistoryHeights::size() const {
+	return _size;
+}
+
+bool HistoryHeights::empty() const {
+	return !_size;
+}
+
+void HistoryHeights::assign(std::vector<int> heights) {
+	_heights = std::move(heights);
+	_offset = 0;
+	_size = int(_heights.size());
+	rebuild(kMinRoom, kMinRoom);
+}
+
+void HistoryHeights::clear() {
+	_heights.clear();
+	_tree.clear();
+	_offset = _size = 0;
+}
+
+void HistoryHeights::pushFront(int height) {
+	if (!_offset) {
+		const auto backRoom = int(_heights.size()) - _size;
+		rebuild(std::max(_size, kMinRoom), backRoom);
+	}
+	--_offset;
+	++_size;
+	_heights[_offset] = height;
+	add(_offset, height);
+}
+
+void HistoryHeights::pushBack(int height) {
+	const auto position = _offset + _size;
+	if (position == int(_heights.size())) {
+		rebuild(_offset, std::max(_size, kMinRoom));
+	}
+	_heights[position] = height;
+	add(position, height);
+	++_size;
+}
+
+void HistoryHeights::set(int index, int height) {
+	Expects(index >= 0 && index < _size);
+
+	const auto position = _offset + index;
+	const auto delta = height - _heights[position];
+	if (delta) {
+		_heights[position] = height;
+		add(position, delta);
+	}
+}
+
+int HistoryHeights::height(int index) const {
+	Expects(index >= 0 && index < _size);
+
+	return _heights[_offset + index];
+}
+
+int HistoryHeights::top(int index) const {
+	Expects(index >= 0 && index <= _size);
+
+	// All the positions in the front room have zero heights.
+	return prefix(_offset + index);
+}
+
+int HistoryHeights::total() const {
+	return top(_size);
+}
+
+int HistoryHeights::findByBottom(int y) const {
+	return std::clamp(countNotAbove(y) - _offset, 0, _size);
+}
+
+int HistoryHeights::findByTop(int y) const {
+	if (y <= 0) {
+		return 0;
+	}
+	const auto above = std::clamp(countNotAbove(y - 1) - _offset, 0, _size);
+	return std::min(above + 1, _size);
+}
+
+void HistoryHeights::rebuild(int frontRoom, int backRoom) {
+	auto heights = std::vector<int>(frontRoom + _size + backRoom, 0);
+	std::copy(
+		begin(_heights) + _offset,
+		begin(_heights) + _offset + _size,
+		begin(heights) + frontRoom);
+	_heights = std::move(heights);
+	_offset = frontRoom;
+
+	const auto capacity = int(_heights.size());
+	_tree.assign(capacity + 1, 0);
+	for (auto i = 1; i <= capacity; ++i) {
+		_tree[i] += _heights[i - 1];
+		const auto parent = i + (i & -i);
+		if (parent <= capacity) {
+			_tree[parent] += _tree[i];
+		}
+	}
+}
+
+void HistoryHeights::add(int position, int delta) {
+	const auto capacity = int(_heights.size());
+	for (++position; position <= capacity; position += (position & -position)) {
+		_tree[position] += delta;
+	}
+}
+
+int HistoryHeights::prefix(int position) const {
+	auto result = 0;
+	for (; position > 0; position -= (position & -position)) {
+		result += _tree[position];
+	}
+	return result;
+}
+
+int HistoryHeights::countNotAbove(int value) const {
+	if (value < 0) {
+		return 0;
+	}
+	const auto capacity = int(_heights.size());
+	auto step = 1;
+	while (step * 2 <= capacity) {
+		step *= 2;
+	}
+	auto position = 0;
+	for (; step > 0; step /= 2) {
+		const auto next = position + step;
+		if (next <= capacity && _tree[next] <= value) {
+			position = next;
+			value -= _tree[next];
+		}
+	}
+	return position;
+}
+
+} // namespace Wallet
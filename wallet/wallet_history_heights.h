@@ -0,0 +1,48 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+namespace Wallet {
+
+// Fenwick tree over row heights with spare room on both ends,
+// so that rows can be added to the front or to the back, and single
+// heights can be changed, with tops recomputed in O(log n).
+class HistoryHeights final {
+public:
+	[[nodiscard]] int size() const;
+	[[nodiscard]] bool empty() const;
+
+	void assign(std::vector<int> heights);
+	void clear();
+	void pushFront(int height);
+	void pushBack(int height);
+	void set(int index, int height);
+
+	[[nodiscard]] int height(int index) const;
+	[[nodiscard]] int top(int index) const;
+	[[nodiscard]] int total() const;
+
+	// Index of the first row with top() + height() > y.
+	[[nodiscard]] int findByBottom(int y) const;
+
+	// Index of the first row with top() >= y.
+	[[nodiscard]] int findByTop(int y) const;
+
+private:
+	void rebuild(int frontRoom, int backRoom);
+	void add(int position, int delta);
+	[[nodiscard]] int prefix(int position) const;
+	[[nodiscard]] int countNotAbove(int value) const;
+
+	std::vector<int> _heights;
+	std::vector<int> _tree;
+	int _offset = 0;
+	int _size = 0;
+
+};
+
+} // namespace Wallet
@@ -0,0 +1,160 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "wallet/wallet_history_search.h"
+
+namespace Wallet {
+namespace {
+
+constexpr auto kTrigramSize = 3;
+constexpr auto kCompactRemovedMin = 256;
+
+[[nodiscard]] QString PrepareText(const QString &text) {
+	return text.toLower();
+}
+
+[[nodiscard]] QString SearchableText(const Ton::Transaction &data) {
+	const auto value = CalculateValue(data);
+	return PrepareText(ExtractMessage(data)
+		+ '\n'
+		+ ExtractAddress(data)
+		+ '\n'
+		+ FormatAmount((value < 0) ? -value : value).full);
+}
+
+[[nodiscard]] uint64 Trigram(const QChar *data) {
+	return (uint64(data[0].unicode()) << 32)
+		| (uint64(data[1].unicode()) << 16)
+		| uint64(data[2].unicode());
+}
+
+[[nodiscard]] std::vector<uint64> Trigrams(const QString &text) {
+	auto result = std::vector<uint64>();
+	const auto count = text.size() - kTrigramSize + 1;
+	if (count <= 0) {
+		return result;
+	}
+	result.reserve(count);
+	for (auto i = 0; i != count; ++i) {
+		result.push_back(Trigram(text.constData() + i));
+	}
+	ranges::sort(result);
+	result.erase(ranges::unique(result), end(result));
+	return result;
+}
+
+} // namespace
+
+void HistorySearchIndex::add(const Ton::Transaction &data) {
+	auto text = SearchableText(data);
+	const auto i = _entryById.find(data.id);
+	if (i != end(_entryById)) {
+		auto &entry = _entries[i->second];
+		if (entry.text == text) {
+			return;
+		}
+		// Postings only grow, the outdated entry is skipped when searching.
+		entry.removed = true;
+		++_removedCount;
+	}
+	add(data.id, std::move(text));
+	if (_removedCount >= kCompactRemovedMin
+		&& _removedCount * 2 >= int(_entries.size())) {
+		compact();
+	}
+}
+
+void HistorySearchIndex::compact() {
+	auto entries = std::move(_entries);
+	clear();
+	for (auto &entry : entries) {
+		if (!entry.removed) {
+			add(entry.id, std::move(entry.text));
+		}
+	}
+}
+
+void HistorySearchIndex::add(const Ton::TransactionId &id, QString text) {
+	const auto index = int(_entries.size());
+	for (const auto trigram : Trigrams(text)) {
+		_postings[trigram].push_back(index);
+	}
+	_entries.push_back({ id, std::move(text) });
+	_entryById[id] = index;
+}
+
+void HistorySearchIndex::clear() {
+	_entries.clear();
+	_entryById.clear();
+	_postings.clear();
+	_removedCount = 0;
+}
+
+QString HistorySearchIndex::PrepareQuery(const QString &query) {
+	return PrepareText(query.trimmed());
+}
+
+bool HistorySearchIndex::matches(
+		const Ton::TransactionId &id,
+		const QString &query) const {
+	const auto i = _entryById.find(id);
+	return (i != end(_entryById))
+		&& _entries[i->second].text.contains(query);
+}
+
+std::vector<Ton::TransactionId> HistorySearchIndex::find(
+		const QString &query) const {
+	auto result = std::vector<Ton::TransactionId>();
+	const auto check = [&](const Entry &entry) {
+		if (!entry.removed && entry.text.contains(query)) {
+			result.push_back(entry.id);
+		}
+	};
+	const auto trigrams = Trigrams(query);
+	if (trigrams.empty()) {
+		for (const auto &entry : _entries) {
+			check(entry);
+		}
+		return result;
+	}
+	auto lists = std::vector<const std::vector<int>*>();
+	lists.reserve(trigrams.size());
+	for (const auto trigram : trigrams) {
+		const auto list = postings(trigram);
+		if (!list) {
+			return result;
+		}
+		lists.push_back(list);
+	}
+	ranges::sort(lists, ranges::less(), &std::vector<int>::size);
+
+	// Intersect the sorted postings starting from the shortest one.
+	auto candidates = *lists.front();
+	for (const auto list : lists | ranges::view::drop(1)) {
+		auto intersection = std::vector<int>();
+		std::set_intersection(
+			begin(candidates),
+			end(candidates),
+			begin(*list),
+			end(*list),
+			std::back_inserter(intersection));
+		candidates = std::move(intersection);
+		if (candidates.empty()) {
+			return result;
+		}
+	}
+	for (const auto index : candidates) {
+		check(_entries[index]);
+	}
+	return result;
+}
+
+const std::vector<int> *HistorySearchIndex::postings(uint64 trigram) const {
+	const auto i = _postings.find(trigram);
+	return (i != end(_postings)) ? &i->second : nullptr;
+}
+
+} // namespace Wallet
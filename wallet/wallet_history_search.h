@@ -0,0 +1,56 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "ton/ton_state.h"
+#include "wallet/wallet_common.h"
+
+#include <unordered_map>
+
+namespace Wallet {
+
+// Trigram index over comments, addresses and amounts of the loaded
+// transactions, updated as transactions arrive or get decrypted.
+class HistorySearchIndex final {
+public:
+	// Adding a transaction that is already indexed replaces its entry.
+	void add(const Ton::Transaction &data);
+	void clear();
+
+	[[nodiscard]] static QString PrepareQuery(const QString &query);
+
+	// Both expect the query already passed through PrepareQuery().
+	[[nodiscard]] bool matches(
+		const Ton::TransactionId &id,
+		const QString &query) const;
+	[[nodiscard]] std::vector<Ton::TransactionId> find(
+		const QString &query) const;
+
+private:
+	struct Entry {
+		Ton::TransactionId id;
+		QString text;
+		bool removed = false;
+	};
+
+	void add(const Ton::TransactionId &id, QString text);
+
+	// Rebuilds the postings without the entries marked as removed.
+	void compact();
+	[[nodiscard]] const std::vector<int> *postings(uint64 trigram) const;
+
+	std::vector<Entry> _entries;
+	std::unordered_map<
+		Ton::TransactionId,
+		int,
+		TransactionIdHash> _entryById;
+	std::unordered_map<uint64, std::vector<int>> _postings;
+	int _removedCount = 0;
+
+};
+
+} // namespace Wallet
@@ -0,0 +1,97 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "wallet/wallet_history_totals.h"
+
+#include "wallet/wallet_common.h"
+
+namespace Wallet {
+
+int64 HistoryTotals::Value(const Ton::Transaction &data) {
+	return CalculateValue(data) - data.fee;
+}
+
+void HistoryTotals::clear() {
+	_entries.clear();
+	_days.clear();
+	_origin = std::nullopt;
+}
+
+bool HistoryTotals::setBalance(int64 balance) {
+	const auto origin = (balance < 0)
+		? std::nullopt
+		: std::make_optional(_entries.empty()
+			? balance
+			: (balance - _entries.front().balance));
+	return (std::exchange(_origin, origin) != origin);
+}
+
+void HistoryTotals::pushFront(
+		const Ton::Transaction &data,
+		const QDate &date) {
+	auto entry = Entry();
+	entry.value = Value(data);
+	entry.day = date.toJulianDay();
+
+	// The balance after the newer transaction includes its value.
+	entry.balance = _entries.empty()
+		? 0
+		: (_entries.front().balance + entry.value);
+	addToDay(entry.day, entry.value);
+	_entries.push_front(entry);
+}
+
+void HistoryTotals::pushBack(
+		const Ton::Transaction &data,
+		const QDate &date) {
+	auto entry = Entry();
+	entry.value = Value(data);
+	entry.day = date.toJulianDay();
+	entry.balance = _entries.empty()
+		? 0
+		: (_entries.back().balance - _entries.back().value);
+	addToDay(entry.day, entry.value);
+	_entries.push_back(entry);
+}
+
+void HistoryTotals::setDate(int index, const QDate &date) {
+	Expects(index >= 0 && index < _entries.size());
+
+	auto &entry = _entries[index];
+	const auto day = date.toJulianDay();
+	if (entry.day != day) {
+		addToDay(entry.day, -entry.value);
+		addToDay(day, entry.value);
+		entry.day = day;
+	}
+}
+
+int HistoryTotals::size() const {
+	return int(_entries.size());
+}
+
+std::optional<int64> HistoryTotals::balanceAfter(int index) const {
+	Expects(index >= 0 && index < _entries.size());
+
+	return _origin
+		? std::make_optional(*_origin + _entries[index].balance)
+		: std::nullopt;
+}
+
+int64 HistoryTotals::dayTotal(const QDate &date) const {
+	const auto i = _days.find(date.toJulianDay());
+	return (i != end(_days)) ? i->second : 0;
+}
+
+void HistoryTotals::addToDay(qint64 day, int64 value) {
+	const auto i = _days.emplace(day, 0).first;
+	i->second += value;
+	if (!i->second) {
+		_days.erase(i);
+	}
+}
+
+} // namespace Wallet
@@ -0,0 +1,57 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "ton/ton_state.h"
+
+#include <deque>
+#include <unordered_map>
+
+namespace Wallet {
+
+// Running balances and per day totals of the loaded transactions.
+// Transactions are added to either end in O(1) each, the balances
+// are kept relative to the first one and anchored by the account.
+class HistoryTotals final {
+public:
+	[[nodiscard]] static int64 Value(const Ton::Transaction &data);
+
+	void clear();
+
+	// Returns true if the balances of the added transactions changed.
+	bool setBalance(int64 balance);
+	void pushFront(const Ton::Transaction &data, const QDate &date);
+	void pushBack(const Ton::Transaction &data, const QDate &date);
+
+	// Moves the transaction to another day, after a time zone change.
+	void setDate(int index, const QDate &date);
+
+	[[nodiscard]] int size() const;
+
+	// Account balance right after the transaction, if known.
+	[[nodiscard]] std::optional<int64> balanceAfter(int index) const;
+
+	[[nodiscard]] int64 dayTotal(const QDate &date) const;
+
+private:
+	struct Entry {
+		int64 value = 0;
+		int64 balance = 0;
+		qint64 day = 0;
+	};
+
+	void addToDay(qint64 day, int64 value);
+
+	std::deque<Entry> _entries;
+	std::unordered_map<qint64, int64> _days;
+
+	// Balance that corresponds to the relative zero, if known.
+	std::optional<int64> _origin;
+
+};
+
+} // namespace Wallet
@@ -11,13 +11,16 @@
 #include "wallet/wallet_cover.h"
 #include "wallet/wallet_empty_history.h"
 #include "wallet/wallet_history.h"
+#include "wallet/wallet_phrases.h"
 #include "ui/rp_widget.h"
 #include "ui/lottie_widget.h"
 #include "ui/widgets/labels.h"
 #include "ui/widgets/scroll_area.h"
 #include "ui/widgets/buttons.h"
+#include "ui/widgets/input_fields.h"
 #include "ui/text/text_utilities.h"
 #include "styles/style_wallet.h"
+#include "styles/palette.h"
 
 #include <QtCore/QDateTime>
 
@@ -38,6 +41,23 @@ void Info::setGeometry(QRect geometry) {
 	_widget->setGeometry(geometry);
 }
 
+void Info::setVisible(bool visible) {
+	_widget->setVisible(visible);
+}
+
+void Info::setCacheHistoryRows(bool enabled) {
+	_history->setRowsCacheEnabled(enabled);
+}
+
+void Info::setShowHistoryBalances(bool show) {
+	_history->setShowBalances(show);
+	_topBar->setBalancesShown(show);
+}
+
+int Info::historyHitTestsPerSecond() const {
+	return _history->hitTestsPerSecond();
+}
+
 rpl::producer<Action> Info::actionRequests() const {
 	return _actionRequests.events();
 }
@@ -54,14 +74,21 @@ rpl::producer<Ton::Transaction> Info::decryptRequests() const {
 	return _decryptRequests.events();
 }
 
+rpl::producer<std::vector<Ton::TransactionId>> Info::listResets() const {
+	return _listResets.events();
+}
+
 void Info::setupControls(Data &&data) {
 	const auto &state = data.state;
 	const auto topBar = _widget->lifetime().make_state<TopBar>(
 		_widget.get(),
 		MakeTopBarState(
 			rpl::duplicate(state),
-			rpl::duplicate(data.updates),
+			rpl::duplicate(data.syncStates),
 			_widget->lifetime()));
+	_topBar = topBar;
+	topBar->setSwitchAccountShown(data.switchAccounts);
+	topBar->setBalancesShown(data.showHistoryBalances);
 	topBar->actionRequests(
 	) | rpl::start_to_stream(_actionRequests, topBar->lifetime());
 
@@ -89,19 +116,69 @@ void Info::setupControls(Data &&data) {
 		std::move(loaded),
 		std::move(data.collectEncrypted),
 		std::move(data.updateDecrypted));
+	_history = history;
+	history->setRowsCacheEnabled(data.cacheHistoryRows);
+	history->setShowBalances(data.showHistoryBalances);
 	const auto emptyHistory = _widget->lifetime().make_state<EmptyHistory>(
 		_inner.get(),
 		MakeEmptyHistoryState(rpl::duplicate(state), data.justCreated),
 		data.share);
 
-	_widget->sizeValue(
-	) | rpl::start_with_next([=](QSize size) {
+	const auto search = Ui::CreateChild<Ui::RpWidget>(_widget.get());
+	const auto field = Ui::CreateChild<Ui::InputField>(
+		search,
+		st::walletSearchField,
+		Ui::InputField::Mode::SingleLine,
+		ph::lng_wallet_search_placeholder());
+	const auto searching = search->lifetime().make_state<
+		rpl::variable<bool>>(false);
+	search->paintRequest(
+	) | rpl::start_with_next([=](QRect clip) {
+		QPainter(search).fillRect(clip, st::windowBg);
+	}, search->lifetime());
+	topBar->searchRequests(
+	) | rpl::start_with_next([=] {
+		*searching = !searching->current();
+	}, search->lifetime());
+	Ui::Connect(field, &Ui::InputField::changed, [=] {
+		history->setSearchQuery(field->getLastText());
+	});
+	Ui::Connect(field, &Ui::InputField::cancelled, [=] {
+		*searching = false;
+	});
+
+	rpl::combine(
+		_widget->sizeValue(),
+		searching->value()
+	) | rpl::start_with_next([=](QSize size, bool shown) {
+		const auto padding = st::walletSearchPadding;
+		const auto searchHeight = shown
+			? (padding.top() + field->height() + padding.bottom())
+			: 0;
+		search->setGeometry(
+			0,
+			st::walletTopBarHeight,
+			size.width(),
+			searchHeight);
+		field->resizeToWidth(size.width() - padding.left() - padding.right());
+		field->moveToLeft(padding.left(), padding.top());
+		search->setVisible(shown);
 		_scroll->setGeometry(QRect(
 			QPoint(),
 			size
-		).marginsRemoved({ 0, st::walletTopBarHeight, 0, 0 }));
+		).marginsRemoved({ 0, st::walletTopBarHeight + searchHeight, 0, 0 }));
 	}, _scroll->lifetime());
 
+	searching->changes(
+	) | rpl::start_with_next([=](bool shown) {
+		if (shown) {
+			field->setFocusFast();
+		} else {
+			field->clear();
+			history->setSearchQuery(QString());
+		}
+	}, search->lifetime());
+
 	_scroll->sizeValue(
 	) | rpl::start_with_next([=](QSize size) {
 		cover->setGeometry(QRect(0, 0, size.width(), st::walletCoverHeight));
@@ -132,6 +209,11 @@ void Info::setupControls(Data &&data) {
 		history->setVisibleTopBottom(scrollTop, scrollTop + scrollHeight);
 	}, history->lifetime());
 
+	history->scrollTopRequests(
+	) | rpl::start_with_next([=](int top) {
+		_scroll->scrollToY(top);
+	}, history->lifetime());
+
 	history->preloadRequests(
 	) | rpl::start_to_stream(_preloadRequests, history->lifetime());
 
@@ -140,6 +222,9 @@ void Info::setupControls(Data &&data) {
 
 	history->decryptRequests(
 	) | rpl::start_to_stream(_decryptRequests, history->lifetime());
+
+	history->listResets(
+	) | rpl::start_to_stream(_listResets, history->lifetime());
 }
 
 rpl::lifetime &Info::lifetime() {
@@ -17,30 +17,43 @@ class ScrollArea;
 namespace Wallet {
 
 enum class Action;
+struct CollectedEncrypted;
+class History;
+class TopBar;
 
 class Info final {
 public:
 	struct Data {
 		rpl::producer<Ton::WalletViewerState> state;
 		rpl::producer<Ton::Result<Ton::LoadedSlice>> loaded;
-		rpl::producer<Ton::Update> updates;
-		rpl::producer<
-			not_null<std::vector<Ton::Transaction>*>> collectEncrypted;
+		rpl::producer<Ton::SyncState> syncStates;
+		rpl::producer<not_null<CollectedEncrypted*>> collectEncrypted;
 		rpl::producer<
 			not_null<const std::vector<Ton::Transaction>*>> updateDecrypted;
 		Fn<void(QImage, QString)> share;
 		bool justCreated = false;
 		bool useTestNetwork = false;
+		bool cacheHistoryRows = false;
+		bool showHistoryBalances = false;
+		bool switchAccounts = false;
 	};
 	Info(not_null<QWidget*> parent, Data data);
 	~Info();
 
 	void setGeometry(QRect geometry);
+	void setVisible(bool visible);
+	void setCacheHistoryRows(bool enabled);
+	void setShowHistoryBalances(bool show);
+
+	// For profiling, see History::hitTestsPerSecond().
+	[[nodiscard]] int historyHitTestsPerSecond() const;
 
 	[[nodiscard]] rpl::producer<Action> actionRequests() const;
 	[[nodiscard]] rpl::producer<Ton::TransactionId> preloadRequests() const;
 	[[nodiscard]] rpl::producer<Ton::Transaction> viewRequests() const;
 	[[nodiscard]] rpl::producer<Ton::Transaction> decryptRequests() const;
+	[[nodiscard]] rpl::producer<
+		std::vector<Ton::TransactionId>> listResets() const;
 
 	[[nodiscard]] rpl::lifetime &lifetime();
 
@@ -50,11 +63,14 @@ private:
 	const std::unique_ptr<Ui::RpWidget> _widget;
 	const not_null<Ui::ScrollArea*> _scroll;
 	const not_null<Ui::RpWidget*> _inner;
+	History *_history = nullptr;
+	TopBar *_topBar = nullptr;
 
 	rpl::event_stream<Action> _actionRequests;
 	rpl::event_stream<Ton::TransactionId> _preloadRequests;
 	rpl::event_stream<Ton::Transaction> _viewRequests;
 	rpl::event_stream<Ton::Transaction> _decryptRequests;
+	rpl::event_stream<std::vector<Ton::TransactionId>> _listResets;
 
 };
 
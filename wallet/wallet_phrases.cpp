@@ -95,6 +95,7 @@ phrase lng_wallet_row_to = "to:";
 phrase lng_wallet_row_init = "Wallet initialization";
 phrase lng_wallet_row_service = "Empty transaction";
 phrase lng_wallet_row_fees = "blockchain fees: {amount}";
+phrase lng_wallet_row_balance = "balance: {amount}";
 phrase lng_wallet_row_pending_date = "Pending";
 phrase lng_wallet_click_to_decrypt = "Enter password to view comment";
 phrase lng_wallet_decrypt_failed = "Decryption failed :(";
@@ -136,10 +137,23 @@ phrase lng_wallet_invoice_qr_share = "Share QR Code";
 phrase lng_wallet_invoice_copied = "Invoice link copied to clipboard.";
 
 phrase lng_wallet_menu_settings = "Settings";
+phrase lng_wallet_menu_switch_account = "Switch wallet";
+phrase lng_wallet_menu_show_balances = "Show balances";
+phrase lng_wallet_menu_hide_balances = "Hide balances";
+phrase lng_wallet_accounts_title = "Wallets";
 phrase lng_wallet_menu_change_passcode = "Change password";
 phrase lng_wallet_menu_export = "Back up wallet";
+phrase lng_wallet_menu_search = "Search history";
+phrase lng_wallet_menu_export_history = "Export history";
 phrase lng_wallet_menu_delete = "Log Out";
 
+phrase lng_wallet_search_placeholder = "Comment, address or amount";
+
+phrase lng_wallet_export_history_title = "Export History";
+phrase lng_wallet_export_history_progress = "Transactions exported: {count}";
+phrase lng_wallet_export_history_done = "Done! Transactions exported: {count}";
+phrase lng_wallet_export_history_failed = "Could not export the history. Please try again later.";
+
 phrase lng_wallet_delete_title = "Log Out";
 phrase lng_wallet_delete_about = "This will disconnect the wallet from this app. You will be able to restore your wallet using **24 secret words** \xe2\x80\x93 or import another wallet.\n\nWallets are located in the decentralized TON Blockchain. If you want the wallet to be deleted simply transfer all the Grams from it and leave it empty.";
 phrase lng_wallet_delete_disconnect = "Disconnect";
@@ -283,6 +297,14 @@ Fn<phrase(QString)> lng_wallet_grams_count_sent = [](QString text) {
 } // namespace ph
 
 namespace Wallet {
+namespace {
+
+[[nodiscard]] rpl::event_stream<> &PhrasesUpdates() {
+	static auto result = rpl::event_stream<>();
+	return result;
+}
+
+} // namespace
 
 void SetPhrases(
 		ph::details::phrase_value_array<kPhrasesCount> data,
@@ -303,6 +325,11 @@ void SetPhrases(
 	ph::lng_wallet_grams_count = [=](QString text) {
 		return ph::phrase{ wallet_grams_count(text) };
 	};
+	PhrasesUpdates().fire({});
+}
+
+rpl::producer<> PhrasesUpdated() {
+	return PhrasesUpdates().events();
 }
 
 } // namespace Wallet
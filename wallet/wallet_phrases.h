@@ -94,6 +94,7 @@ extern phrase lng_wallet_row_to;
 extern phrase lng_wallet_row_init;
 extern phrase lng_wallet_row_service;
 extern phrase lng_wallet_row_fees;
+extern phrase lng_wallet_row_balance;
 extern phrase lng_wallet_row_pending_date;
 extern phrase lng_wallet_click_to_decrypt;
 extern phrase lng_wallet_decrypt_failed;
@@ -135,10 +136,23 @@ extern phrase lng_wallet_invoice_qr_share;
 extern phrase lng_wallet_invoice_copied;
 
 extern phrase lng_wallet_menu_settings;
+extern phrase lng_wallet_menu_switch_account;
+extern phrase lng_wallet_menu_show_balances;
+extern phrase lng_wallet_menu_hide_balances;
+extern phrase lng_wallet_accounts_title;
 extern phrase lng_wallet_menu_change_passcode;
 extern phrase lng_wallet_menu_export;
+extern phrase lng_wallet_menu_search;
+extern phrase lng_wallet_menu_export_history;
 extern phrase lng_wallet_menu_delete;
 
+extern phrase lng_wallet_search_placeholder;
+
+extern phrase lng_wallet_export_history_title;
+extern phrase lng_wallet_export_history_progress;
+extern phrase lng_wallet_export_history_done;
+extern phrase lng_wallet_export_history_failed;
+
 extern phrase lng_wallet_delete_title;
 extern phrase lng_wallet_delete_about;
 extern phrase lng_wallet_delete_disconnect;
@@ -217,7 +231,7 @@ extern Fn<phrase(QString)> lng_wallet_grams_count_sent;
 
 namespace Wallet {
 
-inline constexpr auto kPhrasesCount = 163;
+inline constexpr auto kPhrasesCount = 175;
 
 void SetPhrases(
 	ph::details::phrase_value_array<kPhrasesCount> data,
@@ -227,4 +241,7 @@ void SetPhrases(
 	Fn<rpl::producer<QString>(QString)> wallet_grams_count,
 	Fn<rpl::producer<QString>(QString)> wallet_grams_count_sent);
 
+// Fires after SetPhrases() so that laid out texts can be refreshed.
+[[nodiscard]] rpl::producer<> PhrasesUpdated();
+
 } // namespace Wallet
@@ -0,0 +1,113 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "wallet/wallet_refresh_scheduler.h"
+
+#include <random>
+
+namespace Wallet {
+namespace {
+
+constexpr auto kBackoffMax = 3;
+constexpr auto kDelayMax = 5 * 60 * crl::time(1000);
+constexpr auto kChangedDuration = 60 * crl::time(1000);
+constexpr auto kChangedDivider = 2;
+constexpr auto kJitter = 0.2;
+
+[[nodiscard]] Fn<float64()> DefaultRandom() {
+	const auto generator = std::make_shared<std::mt19937>(
+		std::random_device()());
+	return [=] {
+		return std::uniform_real_distribution<float64>(0., 1.)(*generator);
+	};
+}
+
+} // namespace
+
+RefreshScheduler::RefreshScheduler(
+	Fn<crl::time()> now,
+	Fn<float64()> random)
+: _now(now ? std::move(now) : Fn<crl::time()>(crl::now))
+, _random(random ? std::move(random) : DefaultRandom()) {
+}
+
+void RefreshScheduler::setBase(crl::time delay, RefreshReason reason) {
+	Expects(delay > 0);
+
+	if (_baseDelay == delay && _baseReason == reason) {
+		return;
+	}
+	// The user came back to the window or waits for a sent transaction,
+	// so a backoff from the quiet time must not delay the next payment.
+	const auto attention = (reason == RefreshReason::Sending)
+		|| (reason == RefreshReason::Active
+			&& _baseReason != RefreshReason::Active);
+	if (attention) {
+		_backoff = 0;
+	}
+	_baseDelay = delay;
+	_baseReason = reason;
+	update();
+}
+
+void RefreshScheduler::refreshed(bool changed) {
+	if (changed) {
+		_backoff = 0;
+		_changedAt = _now();
+	} else {
+		_backoff = std::min(_backoff + 1, kBackoffMax);
+		_backoffReason = RefreshReason::Unchanged;
+	}
+	update();
+}
+
+void RefreshScheduler::failed() {
+	_backoff = std::min(_backoff + 1, kBackoffMax);
+	_backoffReason = RefreshReason::Failed;
+	update();
+}
+
+const RefreshDecision &RefreshScheduler::decision() const {
+	return _decision.current();
+}
+
+rpl::producer<RefreshDecision> RefreshScheduler::decisions() const {
+	return _decision.value();
+}
+
+void RefreshScheduler::update() {
+	if (!_baseDelay) {
+		return;
+	}
+	auto result = RefreshDecision();
+	if (_baseReason == RefreshReason::Sending) {
+		// Waiting for a sent transaction, no backoff and no jitter.
+		result.delay = _baseDelay;
+		result.reason = RefreshReason::Sending;
+		_decision = result;
+		return;
+	}
+	const auto changedRecently = _changedAt
+		&& (_now() - _changedAt < kChangedDuration);
+	if (changedRecently && !_backoff) {
+		result.delay = _baseDelay / kChangedDivider;
+		result.reason = RefreshReason::Changed;
+	} else if (_backoff > 0) {
+		result.delay = std::min(_baseDelay << _backoff, kDelayMax);
+		result.reason = _backoffReason;
+		result.backoff = _backoff;
+	} else {
+		result.delay = _baseDelay;
+		result.reason = _baseReason;
+	}
+	const auto jitter = (_random() * 2. - 1.) * kJitter;
+	result.delay = std::max(
+		crl::time(std::round(result.delay * (1. + jitter))),
+		crl::time(1));
+	_decision = result;
+}
+
+} // namespace Wallet
@@ -0,0 +1,73 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+namespace Wallet {
+
+enum class RefreshReason {
+	Sending,
+	Active,
+	Inactive,
+	Changed,
+	Unchanged,
+	Failed,
+};
+
+struct RefreshDecision {
+	crl::time delay = 0;
+	RefreshReason reason = RefreshReason::Active;
+	int backoff = 0;
+
+	friend inline bool operator==(
+			const RefreshDecision &a,
+			const RefreshDecision &b) {
+		return (a.delay == b.delay)
+			&& (a.reason == b.reason)
+			&& (a.backoff == b.backoff);
+	}
+	friend inline bool operator!=(
+			const RefreshDecision &a,
+			const RefreshDecision &b) {
+		return !(a == b);
+	}
+};
+
+// Chooses the delay between the account refreshes. The base delay comes
+// from the window activity, refreshes that bring nothing new or fail back
+// it off exponentially until the window is activated or a send starts,
+// a detected change shortens it for a while, and
+// every decision is jittered so that many clients don't poll together.
+class RefreshScheduler final {
+public:
+	// Both are replaced in tests, random() returns a value in [0, 1).
+	explicit RefreshScheduler(
+		Fn<crl::time()> now = nullptr,
+		Fn<float64()> random = nullptr);
+
+	void setBase(crl::time delay, RefreshReason reason);
+	void refreshed(bool changed);
+	void failed();
+
+	[[nodiscard]] const RefreshDecision &decision() const;
+	[[nodiscard]] rpl::producer<RefreshDecision> decisions() const;
+
+private:
+	void update();
+
+	const Fn<crl::time()> _now;
+	const Fn<float64()> _random;
+
+	crl::time _baseDelay = 0;
+	RefreshReason _baseReason = RefreshReason::Active;
+	crl::time _changedAt = 0;
+	int _backoff = 0;
+	RefreshReason _backoffReason = RefreshReason::Unchanged;
+	rpl::variable<RefreshDecision> _decision;
+
+};
+
+} // namespace Wallet
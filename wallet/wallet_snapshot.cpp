@@ -0,0 +1,212 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#include "wallet/wallet_snapshot.h"
+
+#include "wallet/wallet_common.h"
+
+#include <QtCore/QFile>
+#include <QtCore/QDataStream>
+
+namespace Wallet {
+namespace {
+
+constexpr auto kSnapshotMagic = quint32(0x57534E50);
+constexpr auto kSnapshotVersion = qint32(1);
+constexpr auto kSnapshotTransactionsMax = 32;
+constexpr auto kSnapshotMessagesMax = 256;
+
+void Write(QDataStream &stream, const Ton::TransactionId &id) {
+	stream << qint64(id.lt) << id.hash;
+}
+
+void Write(QDataStream &stream, const Ton::Message &message) {
+	const auto &text = message.message;
+	stream
+		<< message.source
+		<< message.destination
+		<< qint64(message.value)
+		<< (text.decrypted ? QString() : text.text)
+		<< text.encrypted;
+}
+
+void Write(QDataStream &stream, const Ton::Transaction &data) {
+	Write(stream, data.id);
+	stream
+		<< qint64(data.time)
+		<< qint64(data.fee)
+		<< qint64(data.storageFee)
+		<< qint64(data.otherFee);
+	Write(stream, data.incoming);
+	stream << qint32(data.outgoing.size());
+	for (const auto &message : data.outgoing) {
+		Write(stream, message);
+	}
+}
+
+void Read(QDataStream &stream, Ton::TransactionId &id) {
+	auto lt = qint64();
+	stream >> lt >> id.hash;
+	id.lt = lt;
+}
+
+void Read(QDataStream &stream, Ton::Message &message) {
+	auto value = qint64();
+	stream
+		>> message.source
+		>> message.destination
+		>> value
+		>> message.message.text
+		>> message.message.encrypted;
+	message.value = value;
+}
+
+[[nodiscard]] bool Read(QDataStream &stream, Ton::Transaction &data) {
+	Read(stream, data.id);
+	auto time = qint64(), fee = qint64();
+	auto storageFee = qint64(), otherFee = qint64();
+	stream >> time >> fee >> storageFee >> otherFee;
+	data.time = time;
+	data.fee = fee;
+	data.storageFee = storageFee;
+	data.otherFee = otherFee;
+	Read(stream, data.incoming);
+	auto outgoing = qint32();
+	stream >> outgoing;
+	if (stream.status() != QDataStream::Ok
+		|| outgoing < 0
+		|| outgoing > kSnapshotMessagesMax) {
+		return false;
+	}
+	data.outgoing.resize(outgoing);
+	for (auto &message : data.outgoing) {
+		Read(stream, message);
+	}
+	return (stream.status() == QDataStream::Ok);
+}
+
+[[nodiscard]] QByteArray Serialize(
+		const Ton::WalletViewerState &state,
+		bool useTestNetwork) {
+	const auto &wallet = state.wallet;
+	const auto &list = wallet.lastTransactions.list;
+	const auto count = std::min(int(list.size()), kSnapshotTransactionsMax);
+	const auto previousId = (count < int(list.size()))
+		? list[count].id
+		: wallet.lastTransactions.previousId;
+
+	auto result = QByteArray();
+	auto stream = QDataStream(&result, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_6);
+	stream
+		<< kSnapshotMagic
+		<< kSnapshotVersion
+		<< useTestNetwork
+		<< wallet.address
+		<< qint64(wallet.account.fullBalance)
+		<< qint64(wallet.account.lockedBalance)
+		<< qint32(count);
+	for (const auto &data : list | ranges::view::take(count)) {
+		Write(stream, data);
+	}
+	Write(stream, previousId);
+	return result;
+}
+
+} // namespace
+
+std::optional<Ton::WalletViewerState> LoadSnapshot(
+		const QString &path,
+		const QString &address,
+		bool useTestNetwork) {
+	auto file = QFile(path);
+	if (path.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+		return std::nullopt;
+	}
+	auto stream = QDataStream(&file);
+	stream.setVersion(QDataStream::Qt_5_6);
+
+	auto magic = quint32();
+	auto version = qint32();
+	auto testNetwork = false;
+	auto result = Ton::WalletViewerState();
+	auto &wallet = result.wallet;
+	auto fullBalance = qint64();
+	auto lockedBalance = qint64();
+	auto count = qint32();
+	stream >> magic >> version;
+	if (magic != kSnapshotMagic || version != kSnapshotVersion) {
+		return std::nullopt;
+	}
+	stream
+		>> testNetwork
+		>> wallet.address
+		>> fullBalance
+		>> lockedBalance
+		>> count;
+	if (stream.status() != QDataStream::Ok
+		|| testNetwork != useTestNetwork
+		|| wallet.address != address
+		|| count < 0
+		|| count > kSnapshotTransactionsMax) {
+		return std::nullopt;
+	}
+	wallet.account.fullBalance = fullBalance;
+	wallet.account.lockedBalance = lockedBalance;
+	auto &list = wallet.lastTransactions.list;
+	list.resize(count);
+	for (auto &data : list) {
+		if (!Read(stream, data)) {
+			return std::nullopt;
+		}
+	}
+	Read(stream, wallet.lastTransactions.previousId);
+	if (stream.status() != QDataStream::Ok) {
+		return std::nullopt;
+	}
+
+	// Refresh times are not comparable between launches.
+	result.lastRefresh = 0;
+	result.refreshing = true;
+	return result;
+}
+
+void SaveSnapshot(
+		const QString &path,
+		const Ton::WalletViewerState &state,
+		bool useTestNetwork) {
+	if (path.isEmpty()) {
+		return;
+	}
+	SaveFileAsync(path, [bytes = Serialize(state, useTestNetwork)] {
+		return bytes;
+	});
+}
+
+void RemoveSnapshot(const QString &path) {
+	RemoveFileAsync(path);
+}
+
+rpl::producer<Ton::WalletViewerState> WithSnapshot(
+		rpl::producer<Ton::WalletViewerState> live,
+		std::optional<Ton::WalletViewerState> snapshot) {
+	if (!snapshot) {
+		return live;
+	}
+	const auto known = std::make_shared<bool>(false);
+	return rpl::single(
+		std::move(*snapshot)
+	) | rpl::then(std::move(
+		live
+	) | rpl::filter([=](const Ton::WalletViewerState &state) {
+		if (state.wallet.account.fullBalance >= 0) {
+			*known = true;
+		}
+		return *known;
+	}));
+}
+
+} // namespace Wallet
@@ -0,0 +1,34 @@
+// This file is part of Desktop App Toolkit,
+// a set of libraries for developing nice desktop applications.
+//
+// For license and copyright information please follow this link:
+// https://github.com/desktop-app/legal/blob/master/LEGAL
+//
+#pragma once
+
+#include "ton/ton_state.h"
+
+namespace Wallet {
+
+// Last known balance and first transactions of the wallet, so that
+// the account screen has something to show before the first sync.
+// Decrypted comments are never written to the snapshot.
+[[nodiscard]] std::optional<Ton::WalletViewerState> LoadSnapshot(
+	const QString &path,
+	const QString &address,
+	bool useTestNetwork);
+void SaveSnapshot(
+	const QString &path,
+	const Ton::WalletViewerState &state,
+	bool useTestNetwork);
+
+// Removes the file after any save that is still being written.
+void RemoveSnapshot(const QString &path);
+
+// Starts with the snapshot, if there is one, and switches to the live
+// states as soon as the viewer knows the balance.
+[[nodiscard]] rpl::producer<Ton::WalletViewerState> WithSnapshot(
+	rpl::producer<Ton::WalletViewerState> live,
+	std::optional<Ton::WalletViewerState> snapshot);
+
+} // namespace Wallet
@@ -89,6 +89,18 @@ rpl::producer<Action> TopBar::actionRequests() const {
 	return _actionRequests.events();
 }
 
+rpl::producer<> TopBar::searchRequests() const {
+	return _searchRequests.events();
+}
+
+void TopBar::setSwitchAccountShown(bool shown) {
+	_switchAccountShown = shown;
+}
+
+void TopBar::setBalancesShown(bool shown) {
+	_balancesShown = shown;
+}
+
 rpl::lifetime &TopBar::lifetime() {
 	return _widget.lifetime();
 }
@@ -168,6 +180,19 @@ void TopBar::showMenu(not_null<Ui::IconButton*> toggle) {
 		}
 	}));
 
+	menu->addAction(ph::lng_wallet_menu_search(ph::now), [=] {
+		_searchRequests.fire({});
+	});
+	menu->addAction((_balancesShown
+		? ph::lng_wallet_menu_hide_balances
+		: ph::lng_wallet_menu_show_balances)(ph::now), [=] {
+		_actionRequests.fire(Action::ToggleBalances);
+	});
+	if (_switchAccountShown) {
+		menu->addAction(ph::lng_wallet_menu_switch_account(ph::now), [=] {
+			_actionRequests.fire(Action::SwitchAccount);
+		});
+	}
 	menu->addAction(ph::lng_wallet_menu_settings(ph::now), [=] {
 		_actionRequests.fire(Action::ShowSettings);
 	});
@@ -177,6 +202,9 @@ void TopBar::showMenu(not_null<Ui::IconButton*> toggle) {
 	menu->addAction(ph::lng_wallet_menu_export(ph::now), [=] {
 		_actionRequests.fire(Action::Export);
 	});
+	menu->addAction(ph::lng_wallet_menu_export_history(ph::now), [=] {
+		_actionRequests.fire(Action::ExportHistory);
+	});
 	menu->addAction(ph::lng_wallet_menu_delete(ph::now), [=] {
 		_actionRequests.fire(Action::LogOut);
 	});
@@ -194,17 +222,11 @@ void TopBar::showMenu(not_null<Ui::IconButton*> toggle) {
 
 rpl::producer<TopBarState> MakeTopBarState(
 		rpl::producer<Ton::WalletViewerState> &&state,
-		rpl::producer<Ton::Update> &&updates,
+		rpl::producer<Ton::SyncState> &&syncStates,
 		rpl::lifetime &alive) {
 	auto syncs = rpl::single(
 		Ton::SyncState()
-	) | rpl::then(std::move(
-		updates
-	) | rpl::filter([](const Ton::Update &update) {
-		return v::is<Ton::SyncState>(update.data);
-	}) | rpl::map([](const Ton::Update &update) {
-		return v::get<Ton::SyncState>(update.data);
-	}));
+	) | rpl::then(std::move(syncStates));
 	return rpl::combine(
 		std::move(state),
 		std::move(syncs)
@@ -15,7 +15,7 @@ class DropdownMenu;
 
 namespace Ton {
 struct WalletViewerState;
-struct Update;
+struct SyncState;
 } // namespace Ton
 
 namespace Wallet {
@@ -32,6 +32,10 @@ public:
 	TopBar(not_null<Ui::RpWidget*> parent, rpl::producer<TopBarState> state);
 
 	[[nodiscard]] rpl::producer<Action> actionRequests() const;
+	[[nodiscard]] rpl::producer<> searchRequests() const;
+
+	void setSwitchAccountShown(bool shown);
+	void setBalancesShown(bool shown);
 
 	[[nodiscard]] rpl::lifetime &lifetime();
 
@@ -42,13 +46,16 @@ private:
 	const not_null<Ui::RpWidget*> _widgetParent;
 	Ui::RpWidget _widget;
 	rpl::event_stream<Action> _actionRequests;
+	bool _switchAccountShown = false;
+	bool _balancesShown = false;
+	rpl::event_stream<> _searchRequests;
 	base::unique_qptr<Ui::DropdownMenu> _menu;
 
 };
 
 [[nodiscard]] rpl::producer<TopBarState> MakeTopBarState(
 	rpl::producer<Ton::WalletViewerState> &&state,
-	rpl::producer<Ton::Update> &&updates,
+	rpl::producer<Ton::SyncState> &&syncStates,
 	rpl::lifetime &alive);
 
 } // namespace Wallet
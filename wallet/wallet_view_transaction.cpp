@@ -7,6 +7,7 @@
 #include "wallet/wallet_view_transaction.h"
 
 #include "wallet/wallet_common.h"
+#include "wallet/wallet_decrypt_queue.h"
 #include "wallet/wallet_phrases.h"
 #include "ui/amount_label.h"
 #include "ui/address_label.h"
@@ -147,8 +148,7 @@ void SetupScrollByDrag(
 void ViewTransactionBox(
 		not_null<Ui::GenericBox*> box,
 		Ton::Transaction &&data,
-		rpl::producer<
-			not_null<std::vector<Ton::Transaction>*>> collectEncrypted,
+		rpl::producer<not_null<CollectedEncrypted*>> collectEncrypted,
 		rpl::producer<
 			not_null<const std::vector<Ton::Transaction>*>> decrypted,
 		Fn<void(QImage, QString)> share,
@@ -263,13 +263,12 @@ void ViewTransactionBox(
 				}
 			}, comment->lifetime());
 
+			// Sent for decryption each time, the queue skips it once known.
 			std::move(
 				collectEncrypted
-			) | rpl::take(
-				1
 			) | rpl::start_with_next([=](
-				not_null<std::vector<Ton::Transaction>*> list) {
-				list->push_back(data);
+				not_null<CollectedEncrypted*> collected) {
+				collected->viewed.push_back(data);
 			}, comment->lifetime());
 
 			comment->setClickHandlerFilter([=](const auto &...) {
@@ -14,10 +14,12 @@ struct Transaction;
 
 namespace Wallet {
 
+struct CollectedEncrypted;
+
 void ViewTransactionBox(
 	not_null<Ui::GenericBox*> box,
 	Ton::Transaction &&data,
-	rpl::producer<not_null<std::vector<Ton::Transaction>*>> collectEncrypted,
+	rpl::producer<not_null<CollectedEncrypted*>> collectEncrypted,
 	rpl::producer<not_null<const std::vector<Ton::Transaction>*>> decrypted,
 	Fn<void(QImage, QString)> share,
 	Fn<void()> decryptComment,
@@ -11,6 +11,9 @@
 #include "wallet/wallet_info.h"
 #include "wallet/wallet_view_transaction.h"
 #include "wallet/wallet_receive_grams.h"
+#include "wallet/wallet_refresh_scheduler.h"
+#include "wallet/wallet_decrypt_queue.h"
+#include "wallet/wallet_decrypted_cache.h"
 #include "wallet/wallet_create_invoice.h"
 #include "wallet/wallet_invoice_qr.h"
 #include "wallet/wallet_send_grams.h"
@@ -20,12 +23,15 @@
 #include "wallet/wallet_sending_transaction.h"
 #include "wallet/wallet_delete.h"
 #include "wallet/wallet_export.h"
+#include "wallet/wallet_export_history.h"
 #include "wallet/wallet_update_info.h"
 #include "wallet/wallet_settings.h"
+#include "wallet/wallet_snapshot.h"
 #include "wallet/wallet_update_info.h"
 #include "wallet/create/wallet_create_manager.h"
 #include "ton/ton_wallet.h"
 #include "ton/ton_account_viewer.h"
+#include "base/platform/base_platform_info.h"
 #include "base/platform/base_platform_process.h"
 #include "base/qt_signal_producer.h"
 #include "base/last_user_input.h"
@@ -39,6 +45,7 @@
 #include "ui/layers/generic_box.h"
 #include "ui/toast/toast.h"
 #include "styles/style_layers.h"
+#include "styles/style_widgets.h"
 #include "styles/style_wallet.h"
 #include "styles/palette.h"
 
@@ -59,6 +66,8 @@ namespace {
 constexpr auto kRefreshEachDelay = 10 * crl::time(1000);
 constexpr auto kRefreshInactiveDelay = 60 * crl::time(1000);
 constexpr auto kRefreshWhileSendingDelay = 3 * crl::time(1000);
+constexpr auto kRefreshBatchedDelay = 24 * 60 * 60 * crl::time(1000);
+constexpr auto kRefreshBatchDivider = 4;
 
 [[nodiscard]] bool ValidateTransferLink(const QString &link) {
 	return QRegularExpression(
@@ -68,15 +77,29 @@ constexpr auto kRefreshWhileSendingDelay = 3 * crl::time(1000);
 	).match(link.trimmed()).hasMatch();
 }
 
+[[nodiscard]] crl::time BaseRefreshDelay(RefreshReason reason) {
+	switch (reason) {
+	case RefreshReason::Sending: return kRefreshWhileSendingDelay;
+	case RefreshReason::Active: return kRefreshEachDelay;
+	case RefreshReason::Inactive: return kRefreshInactiveDelay;
+	}
+	Unexpected("Reason in BaseRefreshDelay.");
+}
+
 } // namespace
 
 Window::Window(
 	not_null<Ton::Wallet*> wallet,
-	UpdateInfo *updateInfo)
+	UpdateInfo *updateInfo,
+	const QString &snapshotPath,
+	const QString &decryptedPath)
 : _wallet(wallet)
 , _window(std::make_unique<Ui::Window>())
 , _layers(std::make_unique<Ui::LayerManager>(_window->body()))
-, _updateInfo(updateInfo) {
+, _updateInfo(updateInfo)
+, _snapshotPath(snapshotPath)
+, _decryptedPath(decryptedPath)
+, _refreshTimer([=] { refreshAccounts(); }) {
 	init();
 	const auto keys = _wallet->publicKeys();
 	if (keys.empty()) {
@@ -103,9 +126,56 @@ void Window::init() {
 		updatePalette();
 	}, _window->lifetime());
 
+	setupUpdates();
 	startWallet();
 }
 
+void Window::setupUpdates() {
+	_wallet->updates(
+	) | rpl::start_with_next([=](const Ton::Update &update) {
+		v::match(update.data, [&](const Ton::SyncState &data) {
+			countUpdate(&UpdatesCounters::syncState);
+			_syncStates.fire_copy(data);
+		}, [&](const Ton::DecryptPasswordNeeded &data) {
+			countUpdate(&UpdatesCounters::decryptPasswordNeeded);
+			_decryptPasswordNeeded.fire_copy(data);
+		}, [&](const Ton::DecryptPasswordGood &data) {
+			countUpdate(&UpdatesCounters::decryptPasswordGood);
+			_decryptPasswordGood.fire_copy(data);
+		}, [&](auto&&) {
+			countUpdate(&UpdatesCounters::other);
+		});
+	}, _window->lifetime());
+
+	_decryptPasswordNeeded.events(
+	) | rpl::start_with_next([=](const Ton::DecryptPasswordNeeded &data) {
+		askDecryptPassword(data);
+	}, _window->lifetime());
+
+	_decryptPasswordGood.events(
+	) | rpl::start_with_next([=](const Ton::DecryptPasswordGood &data) {
+		doneDecryptPassword(data);
+	}, _window->lifetime());
+}
+
+void Window::countUpdate(int UpdatesCounters::*type) {
+	const auto now = crl::now();
+	if (now - _updatesSecondStart >= 1000) {
+		_updatesLastSecond = (now - _updatesSecondStart < 2000)
+			? _updatesThisSecond
+			: UpdatesCounters();
+		_updatesThisSecond = UpdatesCounters();
+		_updatesSecondStart = now;
+	}
+	++(_updatesThisSecond.*type);
+}
+
+auto Window::updatesPerSecond() const -> UpdatesCounters {
+	return (crl::now() - _updatesSecondStart < 2000)
+		? _updatesLastSecond
+		: UpdatesCounters();
+}
+
 void Window::startWallet() {
 	const auto &was = _wallet->settings().net();
 	if (was.useCustomConfig) {
@@ -142,6 +212,9 @@ void Window::showCreate() {
 	_layers->hideAll();
 	_info = nullptr;
 	_viewer = nullptr;
+	_account = nullptr;
+	_accounts.clear();
+	_refreshTimer.cancel();
 	_updateButton.destroy();
 
 	_window->setTitleStyle(st::defaultWindowTitle);
@@ -341,27 +414,23 @@ void Window::createSavePasscode(
 		return;
 	}
 	rpl::single(
-		Ton::Update{ Ton::SyncState() }
+		Ton::SyncState()
 	) | rpl::then(
-		_wallet->updates()
-	) | rpl::map([](const Ton::Update &update) {
-		return v::match(update.data, [&](const Ton::SyncState &data) {
-			if (!data.valid()
-				|| data.current == data.to
-				|| data.current == data.from) {
-				return ph::lng_wallet_sync();
-			} else {
-				const auto percent = QString::number(
-					(100 * (data.current - data.from)
-						/ (data.to - data.from)));
-				return ph::lng_wallet_sync_percent(
-				) | rpl::map([=](QString &&text) {
-					return text.replace("{percent}", percent);
-				}) | rpl::type_erased();
-			}
-		}, [&](auto&&) {
+		_syncStates.events()
+	) | rpl::map([](const Ton::SyncState &data) {
+		if (!data.valid()
+			|| data.current == data.to
+			|| data.current == data.from) {
 			return ph::lng_wallet_sync();
-		});
+		} else {
+			const auto percent = QString::number(
+				(100 * (data.current - data.from)
+					/ (data.to - data.from)));
+			return ph::lng_wallet_sync_percent(
+			) | rpl::map([=](QString &&text) {
+				return text.replace("{percent}", percent);
+			}) | rpl::type_erased();
+		}
 	}) | rpl::flatten_latest(
 	) | rpl::start_to_stream(_createSyncing, _createManager->lifetime());
 
@@ -396,66 +465,150 @@ void Window::showAccount(const QByteArray &publicKey, bool justCreated) {
 	_importing = false;
 	_createManager = nullptr;
 
-	_address = _wallet->getUsedAddress(publicKey);
-	_viewer = _wallet->createAccountViewer(publicKey, _address);
+	const auto account = findAccount(publicKey);
+	switchToAccount(account
+		? not_null<Account*>(account)
+		: createAccount(publicKey, justCreated));
+}
+
+auto Window::findAccount(const QByteArray &publicKey) const -> Account* {
+	const auto i = ranges::find(
+		_accounts,
+		publicKey,
+		[](const std::unique_ptr<Account> &account) {
+			return account->publicKey;
+		});
+	return (i != end(_accounts)) ? i->get() : nullptr;
+}
+
+void Window::switchToAccount(not_null<Account*> account) {
+	if (_account == account) {
+		return;
+	} else if (_account) {
+		_account->decryptQueue->cancel();
+		_info->setVisible(false);
+	}
+	_account = account;
+	_address = account->address;
+	_viewer = account->viewer.get();
+	_info = account->info.get();
 	_state = _viewer->state() | rpl::map([](Ton::WalletViewerState &&state) {
 		return std::move(state.wallet);
 	});
-	_syncing = false;
-	_syncing = _wallet->updates() | rpl::map([](const Ton::Update &update) {
-		return v::match(update.data, [&](const Ton::SyncState &data) {
+
+	_window->setTitleStyle(st::walletWindowTitle);
+	_info->setVisible(true);
+	_layers->raise();
+}
+
+auto Window::createAccount(const QByteArray &publicKey, bool justCreated)
+-> not_null<Account*> {
+	if (_accounts.empty()) {
+		_syncing = false;
+		_syncing = _syncStates.events(
+		) | rpl::map([](const Ton::SyncState &data) {
 			return data.valid() && (data.current != data.to);
-		}, [&](auto&&) {
-			return false;
 		});
+	}
+
+	_accounts.push_back(std::make_unique<Account>());
+	const auto account = _accounts.back().get();
+	account->publicKey = publicKey;
+	account->address = _wallet->getUsedAddress(publicKey);
+	account->viewer = _wallet->createAccountViewer(
+		publicKey,
+		account->address);
+	const auto viewer = account->viewer.get();
+	account->decryptedCache = std::make_unique<DecryptedCache>(
+		accountPath(_decryptedPath, publicKey));
+	account->decryptQueue = std::make_unique<DecryptQueue>([=](
+			std::vector<Ton::Transaction> list,
+			Fn<void(DecryptQueue::Result)> done) {
+		decryptWithCache(account, std::move(list), std::move(done));
 	});
 
-	_window->setTitleStyle(st::walletWindowTitle);
 	auto data = Info::Data();
 	data.justCreated = justCreated;
-	data.state = _viewer->state();
-	data.loaded = _viewer->loaded();
-	data.updates = _wallet->updates();
-	data.collectEncrypted = _collectEncryptedRequests.events();
-	data.updateDecrypted = _decrypted.events();
+	data.state = WithSnapshot(
+		viewer->state(),
+		LoadSnapshot(
+			accountPath(_snapshotPath, publicKey),
+			account->address,
+			_wallet->settings().useTestNetwork));
+	data.loaded = viewer->loaded();
+	data.syncStates = _syncStates.events();
+	data.collectEncrypted = account->collectEncryptedRequests.events();
+	data.updateDecrypted = account->decryptQueue->decrypted();
 	data.share = shareAddressCallback();
 	data.useTestNetwork = _wallet->settings().useTestNetwork;
-	_info = std::make_unique<Info>(_window->body(), std::move(data));
-	_layers->raise();
+	data.switchAccounts = (_wallet->publicKeys().size() > 1);
+	data.cacheHistoryRows = _cacheHistoryRows;
+	data.showHistoryBalances = _showHistoryBalances;
+	account->info = std::make_unique<Info>(_window->body(), std::move(data));
+	const auto info = account->info.get();
+	info->setVisible(false);
 
-	setupRefreshEach();
+	setupRefreshEach(account);
+	setupSnapshot(account);
 
-	_viewer->loaded(
+	viewer->loaded(
 	) | rpl::filter([](const Ton::Result<Ton::LoadedSlice> &value) {
 		return !value;
 	}) | rpl::map([](Ton::Result<Ton::LoadedSlice> &&value) {
 		return std::move(value.error());
 	}) | rpl::start_with_next([=](const Ton::Error &error) {
 		showGenericError(error);
-	}, _info->lifetime());
+	}, info->lifetime());
+
+	account->decryptQueue->errors(
+	) | rpl::start_with_next([=](const Ton::Error &error) {
+		showGenericError(error);
+	}, info->lifetime());
+
+	account->decryptedCache->unlocks(
+	) | rpl::start_with_next([=] {
+		fillAllFromCache(account);
+	}, info->lifetime());
+
+	// History merges new states and slices before these are called,
+	// so only the transactions that came with them are looked up.
+	viewer->state(
+	) | rpl::start_with_next([=](const Ton::WalletViewerState &state) {
+		fillFromCache(account, state.wallet.lastTransactions.list);
+	}, info->lifetime());
 
-	setupUpdateWithInfo();
+	viewer->loaded(
+	) | rpl::filter([](const Ton::Result<Ton::LoadedSlice> &value) {
+		return value.has_value();
+	}) | rpl::start_with_next([=](const Ton::Result<Ton::LoadedSlice> &value) {
+		fillFromCache(account, value->data.list);
+	}, info->lifetime());
+
+	setupUpdateWithInfo(info);
 
-	_info->actionRequests(
+	info->actionRequests(
 	) | rpl::start_with_next([=](Action action) {
 		switch (action) {
 		case Action::Refresh: refreshNow(); return;
 		case Action::Export: askExportPassword(); return;
+		case Action::ExportHistory: exportHistory(); return;
 		case Action::Send: sendGrams(); return;
 		case Action::Receive: receiveGrams(); return;
 		case Action::ChangePassword: changePassword(); return;
 		case Action::ShowSettings: showSettings(); return;
+		case Action::ToggleBalances: toggleHistoryBalances(); return;
+		case Action::SwitchAccount: showAccounts(); return;
 		case Action::LogOut: logoutWithConfirmation(); return;
 		}
 		Unexpected("Action in Info::actionRequests().");
-	}, _info->lifetime());
+	}, info->lifetime());
 
-	_info->preloadRequests(
+	info->preloadRequests(
 	) | rpl::start_with_next([=](const Ton::TransactionId &id) {
-		_viewer->preloadSlice(id);
-	}, _info->lifetime());
+		viewer->preloadSlice(id);
+	}, info->lifetime());
 
-	_info->viewRequests(
+	info->viewRequests(
 	) | rpl::start_with_next([=](Ton::Transaction &&data) {
 		const auto send = [=](const QString &address) {
 			sendGrams(address);
@@ -463,51 +616,131 @@ void Window::showAccount(const QByteArray &publicKey, bool justCreated) {
 		_layers->showBox(Box(
 			ViewTransactionBox,
 			std::move(data),
-			_collectEncryptedRequests.events(),
-			_decrypted.events(),
+			account->collectEncryptedRequests.events(),
+			account->decryptQueue->decrypted(),
 			shareAddressCallback(),
-			[=] { decryptEverything(publicKey); },
+			[=] { decryptEverything(account); },
 			send));
-	}, _info->lifetime());
+	}, info->lifetime());
 
-	_info->decryptRequests(
-	) | rpl::start_with_next([=] {
-		decryptEverything(publicKey);
-	}, _info->lifetime());
+	info->decryptRequests(
+	) | rpl::start_with_next([=](Ton::Transaction &&data) {
+		decryptEverything(account, { std::move(data) });
+	}, info->lifetime());
 
-	_wallet->updates(
-	) | rpl::filter([](const Ton::Update &update) {
-		return v::is<Ton::DecryptPasswordNeeded>(update.data);
-	}) | rpl::start_with_next([=](const Ton::Update &update) {
-		askDecryptPassword(v::get<Ton::DecryptPasswordNeeded>(update.data));
-	}, _info->lifetime());
+	info->listResets(
+	) | rpl::start_with_next([=](
+			const std::vector<Ton::TransactionId> &ids) {
+		account->decryptQueue->forget(ids);
+	}, info->lifetime());
 
-	_wallet->updates(
-	) | rpl::filter([](const Ton::Update &update) {
-		return v::is<Ton::DecryptPasswordGood>(update.data);
-	}) | rpl::start_with_next([=](const Ton::Update &update) {
-		doneDecryptPassword(v::get<Ton::DecryptPasswordGood>(update.data));
-	}, _info->lifetime());
+	return account;
 }
 
-void Window::decryptEverything(const QByteArray &publicKey) {
-	auto transactions = std::vector<Ton::Transaction>();
-	_collectEncryptedRequests.fire(&transactions);
-	if (transactions.empty()) {
-		return;
+void Window::showAccounts() {
+	const auto current = _account ? _account->publicKey : QByteArray();
+	_layers->showBox(Box([=](not_null<Ui::GenericBox*> box) {
+		box->setTitle(ph::lng_wallet_accounts_title());
+		for (const auto &publicKey : _wallet->publicKeys()) {
+			const auto button = box->addRow(
+				object_ptr<Ui::SettingsButton>(
+					box,
+					rpl::single(_wallet->getUsedAddress(publicKey)),
+					st::defaultSettingsButton),
+				QMargins());
+			button->setDisabled(publicKey == current);
+			button->setClickedCallback([=] {
+				box->closeBox();
+				showAccount(publicKey);
+			});
+		}
+		box->addButton(ph::lng_wallet_cancel(), [=] {
+			box->closeBox();
+		});
+	}));
+}
+
+void Window::toggleHistoryBalances() {
+	_showHistoryBalances = !_showHistoryBalances;
+	for (const auto &account : _accounts) {
+		account->info->setShowHistoryBalances(_showHistoryBalances);
 	}
-	const auto done = [=](
-			const Ton::Result<std::vector<Ton::Transaction>> &result) {
-		if (!result) {
-			showGenericError(result.error());
+}
+
+QString Window::accountPath(
+		const QString &path,
+		const QByteArray &publicKey) const {
+	// The first wallet keeps the path, others get their address appended.
+	const auto keys = _wallet->publicKeys();
+	return (path.isEmpty() || (!keys.empty() && keys.front() == publicKey))
+		? path
+		: (path + '.' + _wallet->getUsedAddress(publicKey));
+}
+
+void Window::decryptEverything(
+		not_null<Account*> account,
+		std::vector<Ton::Transaction> viewed) {
+	auto collected = CollectedEncrypted{ std::move(viewed) };
+	account->collectEncryptedRequests.fire(&collected);
+	account->decryptQueue->push(std::move(collected));
+}
+
+void Window::decryptWithCache(
+		not_null<Account*> account,
+		std::vector<Ton::Transaction> list,
+		Fn<void(Ton::Result<std::vector<Ton::Transaction>>)> done) {
+	const auto cache = account->decryptedCache.get();
+	auto cached = cache->lookup(list);
+	if (!cached.empty()) {
+		list.erase(ranges::remove_if(list, [&](const Ton::Transaction &data) {
+			return ranges::find(cached, data.id, &Ton::Transaction::id)
+				!= end(cached);
+		}), end(list));
+		if (list.empty()) {
+			done(std::move(cached));
 			return;
 		}
-		_decrypted.fire(&result.value());
+	}
+	const auto decrypted = [=](
+			Ton::Result<std::vector<Ton::Transaction>> result) {
+		if (result) {
+			cache->store(result.value());
+			auto &value = result.value();
+			value.insert(end(value), begin(cached), end(cached));
+		}
+		done(std::move(result));
 	};
 	_wallet->decrypt(
-		publicKey,
-		std::move(transactions),
-		crl::guard(this, done));
+		account->publicKey,
+		std::move(list),
+		crl::guard(cache, decrypted));
+}
+
+void Window::fillFromCache(
+		not_null<Account*> account,
+		const std::vector<Ton::Transaction> &list) {
+	const auto cache = account->decryptedCache.get();
+	if (cache->empty()) {
+		return;
+	}
+	const auto found = cache->lookup(list);
+	if (!found.empty()) {
+		account->decryptQueue->apply(found);
+	}
+}
+
+void Window::fillAllFromCache(not_null<Account*> account) {
+	if (account->decryptedCache->empty()) {
+		return;
+	}
+	auto collected = CollectedEncrypted();
+	account->collectEncryptedRequests.fire(&collected);
+	for (const auto list : {
+			&collected.viewed,
+			&collected.visible,
+			&collected.background }) {
+		fillFromCache(account, *list);
+	}
 }
 
 void Window::askDecryptPassword(const Ton::DecryptPasswordNeeded &data) {
@@ -528,6 +761,8 @@ void Window::askDecryptPassword(const Ton::DecryptPasswordNeeded &data) {
 				const QByteArray &passcode,
 				Fn<void(QString)> showError) {
 			_decryptPasswordState->showError = showError;
+			_decryptPasswordState->publicKey = key;
+			_decryptPasswordState->passcode = passcode;
 			_wallet->updateViewersPassword(key, passcode);
 		});
 		QObject::connect(box, &QObject::destroyed, [=] {
@@ -548,18 +783,55 @@ void Window::doneDecryptPassword(const Ton::DecryptPasswordGood &data) {
 	if (_decryptPasswordState
 		&& _decryptPasswordState->generation < data.generation) {
 		_decryptPasswordState->success = true;
+		if (const auto account = findAccount(
+				_decryptPasswordState->publicKey)) {
+			account->decryptedCache->unlock(
+				_decryptPasswordState->passcode);
+		}
 		_decryptPasswordState->box->closeBox();
 	}
 }
 
-void Window::setupUpdateWithInfo() {
-	Expects(_info != nullptr);
+void Window::setupSnapshot(not_null<Account*> account) {
+	const auto path = accountPath(_snapshotPath, account->publicKey);
+	if (path.isEmpty()) {
+		return;
+	}
+	// The snapshot keeps the balances and the first transactions, a
+	// refresh that changed none of them doesn't rewrite the file.
+	using Content = std::tuple<int64, int64, Ton::TransactionId>;
+	const auto saved = std::make_shared<std::optional<Content>>();
+	account->viewer->state(
+	) | rpl::filter([=](const Ton::WalletViewerState &state) {
+		return !state.refreshing
+			&& (state.lastRefresh > 0)
+			&& (state.wallet.account.fullBalance >= 0);
+	}) | rpl::start_with_next([=](const Ton::WalletViewerState &state) {
+		const auto &wallet = state.wallet;
+		const auto &list = wallet.lastTransactions.list;
+		const auto content = Content(
+			wallet.account.fullBalance,
+			wallet.account.lockedBalance,
+			list.empty() ? Ton::TransactionId() : list.front().id);
+		if (*saved == content) {
+			return;
+		}
+		*saved = content;
+		SaveSnapshot(path, state, _wallet->settings().useTestNetwork);
+	}, account->info->lifetime());
+}
 
+void Window::setupUpdateWithInfo(not_null<Info*> info) {
+	auto buttonHeight = _updateButton
+		? _updateButton->heightValue()
+		: rpl::single(0) | rpl::type_erased();
 	rpl::combine(
 		_window->body()->sizeValue(),
-		_updateButtonHeight.events() | rpl::flatten_latest()
+		_updateButtonHeight.events_starting_with(
+			std::move(buttonHeight)
+		) | rpl::flatten_latest()
 	) | rpl::start_with_next([=](QSize size, int height) {
-		_info->setGeometry({ 0, 0, size.width(), size.height() - height });
+		info->setGeometry({ 0, 0, size.width(), size.height() - height });
 		if (height > 0) {
 			_updateButton->setGeometry(
 				0,
@@ -567,10 +839,10 @@ void Window::setupUpdateWithInfo() {
 				size.width(),
 				height);
 		}
-	}, _info->lifetime());
+	}, info->lifetime());
 
-	if (!_updateInfo) {
-		_updateButtonHeight.fire(rpl::single(0));
+	// The update button is shared by all the accounts.
+	if (!_updateInfo || _accounts.size() > 1) {
 		return;
 	}
 
@@ -602,18 +874,26 @@ void Window::setupUpdateWithInfo() {
 			}
 			_updateButton.destroy();
 		}
-	}, _info->lifetime());
+	}, info->lifetime());
 }
 
-void Window::setupRefreshEach() {
-	Expects(_viewer != nullptr);
-	Expects(_info != nullptr);
+void Window::setupRefreshEach(not_null<Account*> account) {
+	const auto viewer = account->viewer.get();
+	const auto info = account->info.get();
 
-	const auto basedOnActivity = _viewer->state(
+	// Viewers don't refresh by themselves, refreshAccounts() does it.
+	// AccountViewer can't turn its own timer off, so it gets a day long
+	// interval that never comes before the batched refreshes.
+	viewer->setRefreshEach(kRefreshBatchedDelay);
+	account->refreshScheduler = std::make_unique<RefreshScheduler>();
+	account->refreshedAt = crl::now();
+	const auto scheduler = account->refreshScheduler.get();
+
+	const auto basedOnActivity = viewer->state(
 	) | rpl::map([] {
 		return (base::SinceLastUserInput() > kRefreshEachDelay)
-			? kRefreshInactiveDelay
-			: kRefreshEachDelay;
+			? RefreshReason::Inactive
+			: RefreshReason::Active;
 	});
 
 	const auto basedOnWindowActive = rpl::single(
@@ -621,20 +901,20 @@ void Window::setupRefreshEach() {
 	) | rpl::then(base::qt_signal_producer(
 		_window->windowHandle(),
 		&QWindow::activeChanged
-	)) | rpl::map([=]() -> rpl::producer<crl::time> {
+	)) | rpl::map([=]() -> rpl::producer<RefreshReason> {
 		if (!_window->isActiveWindow()) {
-			return rpl::single(kRefreshInactiveDelay);
+			return rpl::single(RefreshReason::Inactive);
 		}
 		return rpl::duplicate(basedOnActivity);
 	}) | rpl::flatten_latest();
 
-	const auto basedOnPending = _viewer->state(
+	const auto basedOnPending = viewer->state(
 	) | rpl::map([=](const Ton::WalletViewerState &state) {
 		return !state.wallet.pendingTransactions.empty();
 	}) | rpl::distinct_until_changed(
-	) | rpl::map([=](bool hasPending) -> rpl::producer<crl::time> {
+	) | rpl::map([=](bool hasPending) -> rpl::producer<RefreshReason> {
 		if (hasPending) {
-			return rpl::single(kRefreshWhileSendingDelay);
+			return rpl::single(RefreshReason::Sending);
 		}
 		return rpl::duplicate(basedOnWindowActive);
 	}) | rpl::flatten_latest(
@@ -643,9 +923,96 @@ void Window::setupRefreshEach() {
 	rpl::duplicate(
 		basedOnPending
 	) | rpl::distinct_until_changed(
-	) | rpl::start_with_next([=](crl::time delay) {
-		_viewer->setRefreshEach(delay);
-	}, _info->lifetime());
+	) | rpl::start_with_next([=](RefreshReason reason) {
+		scheduler->setBase(BaseRefreshDelay(reason), reason);
+	}, info->lifetime());
+
+	// A refresh that finished without updating the refresh time failed.
+	struct Refreshed {
+		crl::time time = 0;
+		Ton::TransactionId top;
+		int64 balance = -1;
+		bool refreshing = false;
+	};
+	const auto refreshed = info->lifetime().make_state<Refreshed>();
+	viewer->state(
+	) | rpl::start_with_next([=](const Ton::WalletViewerState &state) {
+		const auto wasRefreshing = std::exchange(
+			refreshed->refreshing,
+			state.refreshing);
+		if (state.refreshing) {
+			return;
+		} else if (state.lastRefresh == refreshed->time) {
+			if (wasRefreshing) {
+				scheduler->failed();
+			}
+			return;
+		}
+		const auto &list = state.wallet.lastTransactions.list;
+		const auto top = list.empty()
+			? Ton::TransactionId()
+			: list.front().id;
+		const auto balance = state.wallet.account.fullBalance;
+		const auto first = !refreshed->time;
+		const auto changed = (refreshed->top != top)
+			|| (refreshed->balance != balance);
+		refreshed->time = state.lastRefresh;
+		refreshed->top = top;
+		refreshed->balance = balance;
+		account->refreshedAt = crl::now();
+		if (!first) {
+			scheduler->refreshed(changed);
+		}
+		scheduleRefresh();
+	}, info->lifetime());
+
+	scheduler->decisions(
+	) | rpl::map([](const RefreshDecision &decision) {
+		return decision.delay;
+	}) | rpl::distinct_until_changed(
+	) | rpl::start_with_next([=] {
+		scheduleRefresh();
+	}, info->lifetime());
+}
+
+void Window::refreshAccounts() {
+	// A single wakeup refreshes every account that is due or would be due
+	// soon, so that the accounts stay aligned on one refresh cycle.
+	const auto now = crl::now();
+	for (const auto &account : _accounts) {
+		const auto delay = account->refreshScheduler->decision().delay;
+		const auto left = account->refreshedAt + delay - now;
+		if (delay > 0 && left <= delay / kRefreshBatchDivider) {
+			account->refreshedAt = now;
+			account->viewer->refreshNow([](Ton::Result<>) {});
+		}
+	}
+	scheduleRefresh();
+}
+
+void Window::scheduleRefresh() {
+	const auto now = crl::now();
+	auto wait = std::optional<crl::time>();
+	for (const auto &account : _accounts) {
+		const auto delay = account->refreshScheduler->decision().delay;
+		if (delay > 0) {
+			const auto due = account->refreshedAt + delay;
+			const auto left = std::max(due - now, crl::time(0));
+			wait = wait ? std::min(*wait, left) : left;
+		}
+	}
+	if (wait) {
+		_refreshTimer.callOnce(*wait);
+	} else {
+		_refreshTimer.cancel();
+	}
+}
+
+void Window::setCacheHistoryRows(bool enabled) {
+	_cacheHistoryRows = enabled;
+	for (const auto &account : _accounts) {
+		account->info->setCacheHistoryRows(enabled);
+	}
 }
 
 void Window::showAndActivate() {
@@ -767,7 +1134,7 @@ void Window::confirmTransaction(
 			showInvoiceError);
 	};
 	_wallet->checkSendGrams(
-		_wallet->publicKeys().front(),
+		_account->publicKey,
 		TransactionFromInvoice(invoice),
 		crl::guard(_sendBox.data(), done));
 }
@@ -775,7 +1142,7 @@ void Window::confirmTransaction(
 void Window::askSendPassword(
 		const PreparedInvoice &invoice,
 		Fn<void(InvoiceField)> showInvoiceError) {
-	const auto publicKey = _wallet->publicKeys().front();
+	const auto publicKey = _account->publicKey;
 	const auto sending = std::make_shared<bool>();
 	const auto ready = [=](
 			const QByteArray &passcode,
@@ -805,7 +1172,10 @@ void Window::askSendPassword(
 			}
 			showSendingTransaction(*result, confirmations->events());
 			_wallet->updateViewersPassword(publicKey, passcode);
-			decryptEverything(publicKey);
+			if (const auto account = findAccount(publicKey)) {
+				account->decryptedCache->unlock(passcode);
+				decryptEverything(account);
+			}
 		};
 		const auto sent = [=](Ton::Result<> result) {
 			if (!result) {
@@ -1181,6 +1551,30 @@ void Window::showSettingsWithLogoutWarning(
 	_layers->showBox(std::move(box));
 }
 
+void Window::exportHistory() {
+	if (!_viewer) {
+		return;
+	}
+	const auto all = Platform::IsWindows() ? "(*.*)" : "(*)";
+	const auto filter = QString("CSV Files (*.csv);;JSON Files (*.json)"
+		";;All Files ") + all;
+	const auto path = QFileDialog::getSaveFileName(
+		_window.get(),
+		ph::lng_wallet_export_history_title(ph::now),
+		"wallet_history.csv",
+		filter);
+	if (path.isEmpty()) {
+		return;
+	}
+	_layers->showBox(Box(
+		HistoryExportBox,
+		std::make_shared<HistoryExport>(
+			_wallet->createAccountViewer(_account->publicKey, _address),
+			_state.current().lastTransactions,
+			path,
+			HistoryExportFormatFromPath(path))));
+}
+
 void Window::askExportPassword() {
 	const auto exporting = std::make_shared<bool>();
 	const auto weakBox = std::make_shared<QPointer<Ui::GenericBox>>();
@@ -1207,7 +1601,7 @@ void Window::askExportPassword() {
 			showExported(*result);
 		};
 		_wallet->exportKey(
-			_wallet->publicKeys().front(),
+			_account->publicKey,
 			passcode,
 			crl::guard(this, ready));
 	};
@@ -1229,12 +1623,25 @@ void Window::logoutWithConfirmation() {
 }
 
 void Window::logout() {
+	// Paths depend on the keys, so they are computed before the deletion.
+	auto snapshots = std::vector<QString>();
+	auto decrypted = std::vector<QString>();
+	for (const auto &publicKey : _wallet->publicKeys()) {
+		snapshots.push_back(accountPath(_snapshotPath, publicKey));
+		decrypted.push_back(accountPath(_decryptedPath, publicKey));
+	}
 	_wallet->deleteAllKeys(crl::guard(this, [=](Ton::Result<> result) {
 		if (!result) {
 			showGenericError(result.error());
 			return;
 		}
 		showCreate();
+		for (const auto &path : snapshots) {
+			RemoveSnapshot(path);
+		}
+		for (const auto &path : decrypted) {
+			RemoveDecryptedCache(path);
+		}
 	}));
 }
 
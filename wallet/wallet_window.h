@@ -9,6 +9,7 @@
 #include "ton/ton_state.h"
 #include "base/weak_ptr.h"
 #include "base/object_ptr.h"
+#include "base/timer.h"
 
 #include <QtCore/QPointer>
 
@@ -41,10 +42,29 @@ class Info;
 struct PreparedInvoice;
 enum class InvoiceField;
 class UpdateInfo;
+class RefreshScheduler;
+class DecryptQueue;
+class DecryptedCache;
+struct CollectedEncrypted;
 
 class Window final : public base::has_weak_ptr {
 public:
-	Window(not_null<Ton::Wallet*> wallet, UpdateInfo *updateInfo = nullptr);
+	// Wallet updates received during a second, by update type.
+	struct UpdatesCounters {
+		int syncState = 0;
+		int decryptPasswordNeeded = 0;
+		int decryptPasswordGood = 0;
+		int other = 0;
+	};
+
+	// An empty snapshotPath disables the warm-start snapshot, an empty
+	// decryptedPath keeps decrypted comments in memory only. Wallets
+	// after the first one append their address to both paths.
+	Window(
+		not_null<Ton::Wallet*> wallet,
+		UpdateInfo *updateInfo = nullptr,
+		const QString &snapshotPath = QString(),
+		const QString &decryptedPath = QString());
 	~Window();
 
 	void showAndActivate();
@@ -52,15 +72,40 @@ public:
 	bool handleLinkOpen(const QString &link);
 	void showConfigUpgrade(Ton::ConfigUpgrade upgrade);
 
+	// Updates throughput during the last complete second, for profiling.
+	[[nodiscard]] UpdatesCounters updatesPerSecond() const;
+
+	// Keeps rendered images of the History rows, see History.
+	// Off by default, the application embedding the Window opts in.
+	void setCacheHistoryRows(bool enabled);
+
 private:
+	// Every opened wallet keeps its viewer and its Info alive,
+	// so that switching between the wallets is instant.
+	struct Account {
+		QByteArray publicKey;
+		QString address;
+		std::unique_ptr<Ton::AccountViewer> viewer;
+		std::unique_ptr<RefreshScheduler> refreshScheduler;
+		crl::time refreshedAt = 0;
+		std::unique_ptr<DecryptedCache> decryptedCache;
+		std::unique_ptr<DecryptQueue> decryptQueue;
+		rpl::event_stream<
+			not_null<CollectedEncrypted*>> collectEncryptedRequests;
+		std::unique_ptr<Info> info;
+	};
 	struct DecryptPasswordState {
 		int generation = 0;
 		bool success = false;
 		QPointer<Ui::GenericBox> box;
 		Fn<void(QString)> showError;
+		QByteArray publicKey;
+		QByteArray passcode;
 	};
 
 	void init();
+	void setupUpdates();
+	void countUpdate(int UpdatesCounters::*type);
 	void updatePalette();
 	void showSimpleError(
 		rpl::producer<QString> title,
@@ -88,13 +133,36 @@ private:
 		const QString &address,
 		std::shared_ptr<bool> guard);
 
-	void decryptEverything(const QByteArray &publicKey);
+	void decryptEverything(
+		not_null<Account*> account,
+		std::vector<Ton::Transaction> viewed = {});
+	void decryptWithCache(
+		not_null<Account*> account,
+		std::vector<Ton::Transaction> list,
+		Fn<void(Ton::Result<std::vector<Ton::Transaction>>)> done);
+	void fillFromCache(
+		not_null<Account*> account,
+		const std::vector<Ton::Transaction> &list);
+	void fillAllFromCache(not_null<Account*> account);
 	void askDecryptPassword(const Ton::DecryptPasswordNeeded &data);
 	void doneDecryptPassword(const Ton::DecryptPasswordGood &data);
 
 	void showAccount(const QByteArray &publicKey, bool justCreated = false);
-	void setupUpdateWithInfo();
-	void setupRefreshEach();
+	[[nodiscard]] Account *findAccount(const QByteArray &publicKey) const;
+	[[nodiscard]] not_null<Account*> createAccount(
+		const QByteArray &publicKey,
+		bool justCreated);
+	void switchToAccount(not_null<Account*> account);
+	void showAccounts();
+	void toggleHistoryBalances();
+	[[nodiscard]] QString accountPath(
+		const QString &path,
+		const QByteArray &publicKey) const;
+	void setupSnapshot(not_null<Account*> account);
+	void setupUpdateWithInfo(not_null<Info*> info);
+	void setupRefreshEach(not_null<Account*> account);
+	void refreshAccounts();
+	void scheduleRefresh();
 	void sendGrams(const QString &invoice = QString());
 	void confirmTransaction(
 		const PreparedInvoice &invoice,
@@ -117,6 +185,7 @@ private:
 	void showInvoiceQr(const QString &link);
 	void changePassword();
 	void askExportPassword();
+	void exportHistory();
 	void showExported(const std::vector<QString> &words);
 	void showSettings();
 	void checkConfigFromContent(QByteArray bytes, Fn<void(QByteArray)> good);
@@ -143,25 +212,38 @@ private:
 	const std::unique_ptr<Ui::Window> _window;
 	const std::unique_ptr<Ui::LayerManager> _layers;
 	UpdateInfo * const _updateInfo = nullptr;
+	const QString _snapshotPath;
+	const QString _decryptedPath;
 
 	std::unique_ptr<Create::Manager> _createManager;
 	rpl::event_stream<QString> _createSyncing;
+
+	// The only subscription to Ton::Wallet::updates(), split by type.
+	rpl::event_stream<Ton::SyncState> _syncStates;
+	rpl::event_stream<Ton::DecryptPasswordNeeded> _decryptPasswordNeeded;
+	rpl::event_stream<Ton::DecryptPasswordGood> _decryptPasswordGood;
+	UpdatesCounters _updatesThisSecond;
+	UpdatesCounters _updatesLastSecond;
+	crl::time _updatesSecondStart = 0;
+
 	bool _importing = false;
 	bool _testnet = false;
+	bool _cacheHistoryRows = false;
+	bool _showHistoryBalances = false;
 
+	std::vector<std::unique_ptr<Account>> _accounts;
+	base::Timer _refreshTimer;
+
+	// The shown account and its parts.
+	Account *_account = nullptr;
 	QString _address;
-	std::unique_ptr<Ton::AccountViewer> _viewer;
+	Ton::AccountViewer *_viewer = nullptr;
+	Info *_info = nullptr;
 	rpl::variable<Ton::WalletState> _state;
 	rpl::variable<bool> _syncing;
-	std::unique_ptr<Info> _info;
 	object_ptr<Ui::FlatButton> _updateButton = { nullptr };
 	rpl::event_stream<rpl::producer<int>> _updateButtonHeight;
 
-	rpl::event_stream<
-		not_null<std::vector<Ton::Transaction>*>> _collectEncryptedRequests;
-	rpl::event_stream<
-		not_null<const std::vector<Ton::Transaction>*>> _decrypted;
-
 	QPointer<Ui::GenericBox> _sendBox;
 	QPointer<Ui::GenericBox> _sendConfirmBox;
 	QPointer<Ui::GenericBox> _simpleErrorBox;